@@ -125,15 +125,10 @@ adsGain_t Adafruit_ADS1015::getGain()
 
 /**************************************************************************/
 /*!
-    @brief  Gets a single-ended ADC reading from the specified channel
+    @brief  Builds the config register value for a single-ended conversion
 */
 /**************************************************************************/
-uint16_t Adafruit_ADS1015::readADC_SingleEnded(uint8_t channel) {
-  if (channel > 3)
-  {
-    return 0;
-  }
-
+uint16_t Adafruit_ADS1015::singleEndedConfig(uint8_t channel) {
   // Start with default values
   uint16_t config = ADS1015_REG_CONFIG_CQUE_NONE    | // Disable the comparator (default val)
                     ADS1015_REG_CONFIG_CLAT_NONLAT  | // Non-latching (default val)
@@ -165,8 +160,22 @@ uint16_t Adafruit_ADS1015::readADC_SingleEnded(uint8_t channel) {
   // Set 'start single-conversion' bit
   config |= ADS1015_REG_CONFIG_OS_SINGLE;
 
+  return config;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets a single-ended ADC reading from the specified channel
+*/
+/**************************************************************************/
+uint16_t Adafruit_ADS1015::readADC_SingleEnded(uint8_t channel) {
+  if (channel > 3)
+  {
+    return 0;
+  }
+
   // Write config register to the ADC
-  writeRegister(m_i2cAddress, ADS1015_REG_POINTER_CONFIG, config);
+  writeRegister(m_i2cAddress, ADS1015_REG_POINTER_CONFIG, singleEndedConfig(channel));
 
   // Wait for the conversion to complete
   delay(m_conversionDelay);
@@ -176,6 +185,47 @@ uint16_t Adafruit_ADS1015::readADC_SingleEnded(uint8_t channel) {
   return readRegister(m_i2cAddress, ADS1015_REG_POINTER_CONVERT) >> m_bitShift;
 }
 
+/**************************************************************************/
+/*!
+    @brief  Queues a single-ended conversion on the asynchronous I2C
+            engine. Conversions on the same ADC run one after the other.
+*/
+/**************************************************************************/
+bool Adafruit_ADS1015::queueADC_SingleEnded(uint8_t channel, WireJob *job) {
+  if (channel > 3)
+  {
+    return false;
+  }
+
+  uint16_t config = singleEndedConfig(channel);
+
+  memset(job, 0, sizeof(WireJob));
+  job->address = m_i2cAddress;
+  job->tx[0] = ADS1015_REG_POINTER_CONFIG;
+  job->tx[1] = (uint8_t)(config >> 8);
+  job->tx[2] = (uint8_t)(config & 0xFF);
+  job->txSize = 3;
+  job->delayMs = m_conversionDelay;
+  job->rxReg = ADS1015_REG_POINTER_CONVERT;
+  job->rxSize = 2;
+
+  return Wire.queue(job);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the result of a conversion queued with
+            queueADC_SingleEnded(), 0 if it failed
+*/
+/**************************************************************************/
+uint16_t Adafruit_ADS1015::getJobResult(const WireJob *job) {
+  if (!job->done || job->status != ESP_OK)
+  {
+    return 0;
+  }
+  return ((job->rx[0] << 8) | job->rx[1]) >> m_bitShift;
+}
+
 /**************************************************************************/
 /*!
     @brief  Reads the conversion results, measuring the voltage
@@ -131,8 +131,11 @@ protected:
   int16_t   getLastConversionResults();
   void      setGain(adsGain_t gain);
   adsGain_t getGain(void);
+  bool      queueADC_SingleEnded(uint8_t channel, WireJob *job);
+  uint16_t  getJobResult(const WireJob *job);
 
  private:
+  uint16_t  singleEndedConfig(uint8_t channel);
 };
 
 // Derive from ADS1105 & override construction to set properties
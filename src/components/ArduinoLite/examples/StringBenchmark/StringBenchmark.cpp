@@ -0,0 +1,56 @@
+/**
+ * Counts the heap allocations String makes while building a typical status page, with and without the arena.
+ *
+ * It runs on the host:
+ *   g++ -O2 -I../../src StringBenchmark.cpp ../../src/WString.cpp -o bench && ./bench
+ *   g++ -O2 -I../../src -DSTRING_ARENA_SIZE=2048 StringBenchmark.cpp ../../src/WString.cpp -o bench && ./bench
+ * Every iteration stands for one wake: the arena is reset at the end, once none of its Strings is alive.
+ */
+#include <chrono>
+#include <utility>
+#include "WString.h"
+
+#define WAKES 1000
+
+#ifndef ESP_PLATFORM // newlib has them, glibc doesn't
+char* ltoa(long val, char *s, int radix) { sprintf(s, radix == 16 ? "%lx" : "%ld", val); return s; }
+char* ultoa(unsigned long val, char *s, int radix) { sprintf(s, radix == 16 ? "%lx" : "%lu", val); return s; }
+char* itoa(int val, char *s, int radix) { return ltoa(val, s, radix); }
+char* utoa(unsigned int val, char *s, int radix) { return ultoa(val, s, radix); }
+#endif
+
+static const char *keys[] = {"bat", "sol", "l1", "l2", "temp", "hum", "pres", "wind"};
+
+static unsigned int wake(int n)
+{
+    String page = "# Station #\n";
+    for (int i = 0; i < 8; i++) {
+        String line = String(keys[i]) + ": " + String(n * 0.37f + i, 2);
+        line += (i % 2) ? " V" : " C";
+        page += line;
+        page += "\n";
+    }
+    page.replace(" C", " \xB0" "C");
+    String moved = std::move(page);
+    return moved.length();
+}
+
+int main()
+{
+    unsigned int total = 0, heap = 0, blocks = 0, peak = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < WAKES; i++) {
+        total += wake(i);
+        string_arena_stats_t stats = String::arenaStats();
+        heap += stats.heap_allocations;
+        blocks += stats.allocations;
+        if (stats.peak > peak) peak = stats.peak;
+        String::resetArena();
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    printf("arena: %d bytes, per wake: %.1f heap allocations, %.1f arena blocks, %u bytes peak, %lld ns (%u chars)\n",
+        STRING_ARENA_SIZE, (float)heap / WAKES, (float)blocks / WAKES, peak, (long long)elapsed / WAKES, total);
+    return 0;
+}
@@ -0,0 +1,55 @@
+/**
+ * Compares single transactions with batched ones, reading the 11 calibration
+ * registers of a BMP180 (22 bytes) like its driver used to and like it does now.
+ *
+ * Build with WIRE_MOCK_BUS=1 to run without any device on the bus, e.g. in the project's CMakeLists.txt:
+ *   idf_build_set_property(COMPILE_DEFINITIONS "-DWIRE_MOCK_BUS=1" APPEND)
+ * The mock bus takes the time the transfers would take at 200 kHz, what's left is the software overhead.
+ */
+#include "Arduino.h"
+#include "Wire.h"
+
+#define DEVICE_ADDRESS 0x77
+#define FIRST_REGISTER 0xAA
+#define REGISTERS 11
+#define ITERATIONS 100
+
+static uint8_t data[REGISTERS * 2];
+
+static void readSingle()
+{
+    for (int i = 0; i < REGISTERS; i++) {
+        Wire.beginTransmission(DEVICE_ADDRESS);
+        Wire.write(FIRST_REGISTER + i * 2);
+        Wire.endTransmission();
+        Wire.requestFrom(DEVICE_ADDRESS, 2);
+        data[i * 2] = Wire.read();
+        data[i * 2 + 1] = Wire.read();
+    }
+}
+
+static void readBatched()
+{
+    Wire.beginBatch();
+    Wire.batchRead(DEVICE_ADDRESS, FIRST_REGISTER, data, sizeof(data));
+    Wire.endBatch();
+}
+
+static void benchmark(const char *name, void (*fn)(), int transactions)
+{
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < ITERATIONS; i++) {
+        fn();
+    }
+    int64_t elapsed = (esp_timer_get_time() - start) / ITERATIONS;
+    printf("%-8s %6lld us per read, %5lld us per transaction\n", name, elapsed, elapsed / transactions);
+}
+
+extern "C" void app_main()
+{
+    Wire.begin(21, 22);
+
+    printf("Reading %u bytes %d times (mock bus: %s)\n", (unsigned)sizeof(data), ITERATIONS, WIRE_MOCK_BUS ? "yes" : "no");
+    benchmark("Single", readSingle, REGISTERS * 2);
+    benchmark("Batched", readBatched, 1);
+}
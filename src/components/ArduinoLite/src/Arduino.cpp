@@ -1,4 +1,9 @@
 #include "Arduino.h"
+#include "esp_adc_cal.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
 static int8_t adc_gpios[] = {
     21, -1, 22, -1, 20, -1, -1, -1, -1, -1,
     -1, -1, 25, 24, 26, 23, -1, -1, -1, -1,
@@ -7,6 +12,51 @@ static int8_t adc_gpios[] = {
 };
 
 static adc_bits_width_t adc_resolution = ADC_WIDTH_BIT_12;
+static adc_bits_width_t adc1_width = ADC_WIDTH_MAX; // What ADC1 is currently set to
+
+// Per pin setup, so that we only talk to the ADC controller when something changes
+static struct {
+    bool configured;
+    adc_atten_t atten;
+    esp_adc_cal_characteristics_t *cal; // Shared by every pin of the same unit and attenuation
+} adc_pins[40];
+
+static esp_adc_cal_characteristics_t adc_cal[2][ADC_ATTEN_MAX];
+static bool adc_cal_done[2][ADC_ATTEN_MAX];
+
+
+static bool adcConfigure(uint8_t pin, adc_atten_t atten, adc_bits_width_t width)
+{
+    if (pin >= 40 || adc_gpios[pin] == -1) {
+        return false;
+    }
+    if (adc_gpios[pin] < 20 && adc1_width != width) {
+        adc1_config_width(width);
+        adc1_width = width;
+    }
+    if (!adc_pins[pin].configured || adc_pins[pin].atten != atten) {
+        if (adc_gpios[pin] < 20) {
+            adc1_config_channel_atten((adc1_channel_t)(adc_gpios[pin] - 10), atten);
+        } else {
+            adc2_config_channel_atten((adc2_channel_t)(adc_gpios[pin] - 20), atten);
+        }
+        adc_pins[pin].configured = true;
+        adc_pins[pin].atten = atten;
+        adc_pins[pin].cal = NULL;
+    }
+    return true;
+}
+
+static int adcSample(uint8_t pin, adc_bits_width_t width)
+{
+    int value = 0;
+    if (adc_gpios[pin] < 20) {
+        value = adc1_get_raw((adc1_channel_t)(adc_gpios[pin] - 10));
+    } else if (adc2_get_raw((adc2_channel_t)(adc_gpios[pin] - 20), width, &value) != ESP_OK) {
+        value = -1; // Busy, WiFi probably has it
+    }
+    return value;
+}
 
 
 void pinMode(uint8_t pin, uint16_t mode)
@@ -29,20 +79,70 @@ void digitalWrite(uint8_t pin, uint16_t val)
 
 uint16_t analogRead(uint8_t pin)
 {
-    if (pin >= 40 || adc_gpios[pin] == -1) {
+    adc_atten_t atten = (pin < 40 && adc_pins[pin].configured) ? adc_pins[pin].atten : ADC_ATTEN_DB_11;
+    if (!adcConfigure(pin, atten, adc_resolution)) {
         return 0;
-    } else if (adc_gpios[pin] < 20) {
-        adc1_channel_t channel = (adc1_channel_t)(adc_gpios[pin] - 10);
-        adc1_config_width(adc_resolution);
-        adc1_config_channel_atten(channel, ADC_ATTEN_DB_11);
-        return adc1_get_raw(channel);
-    } else {
-        adc2_channel_t channel = (adc2_channel_t)(adc_gpios[pin] - 20);
-        int value = 0;
-        adc2_config_channel_atten(channel, ADC_ATTEN_DB_11);
-        adc2_get_raw((adc2_channel_t)channel, adc_resolution, &value);
-        return value;
     }
+    int value = adcSample(pin, adc_resolution);
+    return value < 0 ? 0 : value;
+}
+
+bool analogSetup(uint8_t pin, adc_atten_t atten)
+{
+    if (!adcConfigure(pin, atten, ADC_WIDTH_BIT_12)) {
+        return false;
+    }
+    if (adc_pins[pin].cal == NULL) {
+        int unit = (adc_gpios[pin] < 20) ? 0 : 1;
+        if (!adc_cal_done[unit][atten]) {
+            esp_adc_cal_value_t source = esp_adc_cal_characterize(unit ? ADC_UNIT_2 : ADC_UNIT_1, atten,
+                ADC_WIDTH_BIT_12, 1100, &adc_cal[unit][atten]);
+            ESP_LOGD("ADC", "Unit %d atten %d calibrated from %s", unit + 1, atten,
+                source == ESP_ADC_CAL_VAL_EFUSE_TP ? "two point" : (source == ESP_ADC_CAL_VAL_EFUSE_VREF ? "eFuse vref" : "default vref"));
+            adc_cal_done[unit][atten] = true;
+        }
+        adc_pins[pin].cal = &adc_cal[unit][atten];
+    }
+    return true;
+}
+
+int analogReadMilliVolts(uint8_t pin, uint8_t samples, bool reject)
+{
+    uint16_t values[ADC_MAX_SAMPLES];
+    int count = 0;
+
+    if (pin >= 40 || !analogSetup(pin, adc_pins[pin].configured ? adc_pins[pin].atten : ADC_ATTEN_DB_11)) {
+        return -1;
+    }
+    if (samples < 1) samples = 1;
+    if (samples > ADC_MAX_SAMPLES) samples = ADC_MAX_SAMPLES;
+
+    for (int i = 0; i < samples; i++) {
+        int value = adcSample(pin, ADC_WIDTH_BIT_12);
+        if (value < 0) continue;
+        // Insertion sort as we go, it's at most 64 elements
+        int j = count++;
+        for (; reject && j > 0 && values[j - 1] > value; j--) {
+            values[j] = values[j - 1];
+        }
+        values[j] = value;
+    }
+
+    if (count == 0) {
+        return -1;
+    }
+
+    int first = 0, last = count;
+    if (reject && count >= 4) {
+        first = count / 4;
+        last = count - count / 4;
+    }
+    uint32_t sum = 0;
+    for (int i = first; i < last; i++) {
+        sum += values[i];
+    }
+    uint32_t raw = (sum + (last - first) / 2) / (last - first);
+    return esp_adc_cal_raw_to_voltage(raw, adc_pins[pin].cal);
 }
 
 void analogReadResolution(uint8_t bits)
@@ -64,14 +164,62 @@ void analogWrite(uint8_t pin, uint16_t val)
     }
 }
 
-void attachInterrupt(uint8_t interrupt, void (*userFunc)(void), int mode, void *arg)
+// Every pin goes through the same trampoline, the table lets handlers be swapped without touching the ISR service
+typedef struct {
+    void (*func)(void*);
+    void *arg;
+    int mode;
+} isr_entry_t;
+
+DRAM_ATTR static isr_entry_t isr_handlers[40];
+static bool isr_service = false;
+
+static void IRAM_ATTR isrDispatch(void *arg)
+{
+    isr_entry_t *entry = &isr_handlers[(intptr_t)arg];
+    if (entry->func) {
+        entry->func(entry->arg);
+    }
+}
+
+static void IRAM_ATTR isrNoArg(void *func)
 {
+    ((void (*)(void))func)();
+}
 
+void attachInterruptArg(int pin, void (*userFunc)(void*), void *arg, int mode)
+{
+    if (!digitalPinIsValid(pin)) {
+        return;
+    }
+    if (!isr_service) {
+        esp_err_t err = gpio_install_isr_service(0);
+        isr_service = (err == ESP_OK || err == ESP_ERR_INVALID_STATE); // Someone else may have installed it
+    }
+    gpio_intr_disable((gpio_num_t)pin);
+    isr_handlers[pin].func = userFunc;
+    isr_handlers[pin].arg = arg;
+    isr_handlers[pin].mode = mode;
+    gpio_set_intr_type((gpio_num_t)pin, (gpio_int_type_t)mode);
+    gpio_isr_handler_add((gpio_num_t)pin, isrDispatch, (void*)(intptr_t)pin);
+    gpio_intr_enable((gpio_num_t)pin);
 }
 
-void detachInterrupt(uint8_t interrupt)
+void attachInterrupt(int pin, void (*userFunc)(void), int mode)
 {
+    attachInterruptArg(pin, isrNoArg, (void*)userFunc, mode);
+}
 
+void detachInterrupt(int pin)
+{
+    if (!digitalPinIsValid(pin)) {
+        return;
+    }
+    gpio_intr_disable((gpio_num_t)pin);
+    gpio_isr_handler_remove((gpio_num_t)pin);
+    gpio_set_intr_type((gpio_num_t)pin, GPIO_INTR_DISABLE);
+    isr_handlers[pin].func = NULL;
+    isr_handlers[pin].arg = NULL;
 }
 
 inline void interrupts()
@@ -84,18 +232,55 @@ inline void noInterrupts()
     //
 }
 
+typedef struct {
+    uint8_t pin;
+    uint8_t state;
+    volatile int64_t start;     // 0 until the pulse begins
+    volatile int64_t end;
+    SemaphoreHandle_t done;
+} pulse_t;
+
+static void IRAM_ATTR pulseEdge(void *arg)
+{
+    pulse_t *pulse = (pulse_t*)arg;
+    int64_t now = esp_timer_get_time();
+    BaseType_t woken = pdFALSE;
+
+    if (gpio_get_level((gpio_num_t)pulse->pin) == pulse->state) {
+        if (pulse->start == 0) pulse->start = now;
+    } else if (pulse->start != 0 && pulse->end == 0) {
+        pulse->end = now;
+        xSemaphoreGiveFromISR(pulse->done, &woken);
+    }
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+// A pulse already in progress is ignored, we wait for the next one like Arduino does
 unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout)
 {
-    timeout += micros();
-    while (timeout < micros() && digitalRead(pin) == state);
-    while (timeout < micros()) {
-        if (digitalRead(pin) == state) {
-            unsigned long pulse_start = micros();
-            while (timeout < micros() && digitalRead(pin) == state);
-            return micros() - pulse_start;
-        }
+    pulse_t pulse = {pin, state, 0, 0, xSemaphoreCreateBinary()};
+    isr_entry_t previous = isr_handlers[pin < 40 ? pin : 0];
+    unsigned long width = 0;
+
+    if (!digitalPinIsValid(pin) || pulse.done == NULL) {
+        if (pulse.done) vSemaphoreDelete(pulse.done);
+        return 0;
+    }
+
+    attachInterruptArg(pin, pulseEdge, &pulse, CHANGE);
+    TickType_t ticks = timeout / 1000 / portTICK_PERIOD_MS + 1;
+    if (xSemaphoreTake(pulse.done, ticks) == pdTRUE && pulse.end - pulse.start <= (int64_t)timeout) {
+        width = pulse.end - pulse.start;
+    }
+    detachInterrupt(pin);
+
+    if (previous.func) {
+        attachInterruptArg(pin, previous.func, previous.arg, previous.mode);
     }
-    return 0;
+    vSemaphoreDelete(pulse.done);
+    return width;
 }
 
 unsigned long pulseInLong(uint8_t pin, uint8_t state, unsigned long timeout)
@@ -31,6 +31,12 @@ typedef unsigned int word;
 #define INPUT_PULLDOWN  GPIO_MODE_INPUT|(GPIO_PULLDOWN_ONLY << 8)
 #define OUTPUT          GPIO_MODE_OUTPUT|(GPIO_FLOATING << 8)
 
+#define RISING          GPIO_INTR_POSEDGE
+#define FALLING         GPIO_INTR_NEGEDGE
+#define CHANGE          GPIO_INTR_ANYEDGE
+#define ONLOW           GPIO_INTR_LOW_LEVEL
+#define ONHIGH          GPIO_INTR_HIGH_LEVEL
+
 #define digitalPinIsValid(pin)      ((pin) < 40)
 #define digitalPinToInterrupt(pin)  (digitalPinIsValid(pin) ? (pin) : -1)
 #define digitalPinHasPWM(pin)       ((pin) < 36)
@@ -66,16 +72,26 @@ void digitalWrite(uint8_t pin, uint16_t val);
 
 uint16_t analogRead(uint8_t pin);
 void analogReadResolution(uint8_t bits);
+
+// Calibrated ADC (esp_adc_cal, 12 bits). Each pin is configured on first use, or with analogSetup()
+// to pick another attenuation. Readings average `samples` conversions, `reject` drops the outer quarters
+// of the sorted samples (spikes) before averaging. ADC2 pins don't work while WiFi is on.
+#define ADC_MAX_SAMPLES 64
+bool analogSetup(uint8_t pin, adc_atten_t atten = ADC_ATTEN_DB_11);
+int analogReadMilliVolts(uint8_t pin, uint8_t samples = 16, bool reject = false);
 void analogWrite(uint8_t pin, uint16_t val);
 
-void attachInterrupt(int interrupt, void (*userFunc)(void), int mode, void *arg = NULL);
+// Handlers run from the GPIO ISR service, keep them short (and IRAM_ATTR if they must run during flash writes)
+void attachInterrupt(int interrupt, void (*userFunc)(void), int mode);
+void attachInterruptArg(int interrupt, void (*userFunc)(void*), void *arg, int mode);
 void detachInterrupt(int interrupt);
 
 void interrupts();
 void noInterrupts();
 
-unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout);
-unsigned long pulseInLong(uint8_t pin, uint8_t state, unsigned long timeout);
+// Edges are timestamped by an interrupt, so pulses shorter than the ISR latency (~5us) can't be measured
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
+unsigned long pulseInLong(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
 
 uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder);
 void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t value);
@@ -20,6 +20,9 @@
  Modified 03 August 2015 by Chuck Todd
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // fopencookie()
+#endif
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -41,6 +44,45 @@ size_t Print::write(const uint8_t *buffer, size_t size)
   return n;
 }
 
+static ssize_t printCookieWrite(void *cookie, const char *data, size_t size)
+{
+  return ((Print *)cookie)->write((const uint8_t *)data, size);
+}
+
+size_t Print::printf(const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  size_t n = vprintf(format, args);
+  va_end(args);
+  return n;
+}
+
+size_t Print::vprintf(const char *format, va_list args)
+{
+  char chunk[PRINT_PRINTF_CHUNK];
+  va_list copy;
+
+  // Most output fits in one chunk
+  va_copy(copy, args);
+  int length = vsnprintf(chunk, sizeof(chunk), format, copy);
+  va_end(copy);
+  if (length < 0) return 0;
+  if ((size_t)length < sizeof(chunk)) return write((const uint8_t *)chunk, length);
+
+  // Otherwise stdio formats straight into write(), using the chunk as its buffer
+  cookie_io_functions_t io = {NULL, printCookieWrite, NULL, NULL};
+  FILE *stream = fopencookie(this, "w", io);
+  if (stream == NULL) {
+    setWriteError();
+    return write((const uint8_t *)chunk, sizeof(chunk) - 1);
+  }
+  setvbuf(stream, chunk, _IOFBF, sizeof(chunk));
+  vfprintf(stream, format, args);
+  fclose(stream);
+  return length;
+}
+
 size_t Print::print(const __FlashStringHelper *ifsh)
 {
   PGM_P p = reinterpret_cast<PGM_P>(ifsh);
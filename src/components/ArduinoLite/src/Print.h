@@ -22,6 +22,7 @@
 
 #include <inttypes.h>
 #include <stdio.h> // for size_t
+#include <stdarg.h>
 
 #include "WString.h"
 
@@ -33,6 +34,8 @@
 #endif
 #define BIN 2
 
+#define PRINT_PRINTF_CHUNK 64 // Stack buffer printf() formats through before calling write()
+
 class Printable;
 
 class Print
@@ -88,6 +91,10 @@ class Print
     size_t println(const Printable&);
     size_t println(void);
 
+    // Formatted output is streamed to write(), there is no length limit and no intermediate copy
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    size_t vprintf(const char *format, va_list args);
+
     virtual void flush() { /* Empty implementation for backward compatibility */ }
 };
 
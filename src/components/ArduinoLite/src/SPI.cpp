@@ -6,6 +6,8 @@
 #include "esp_system.h"
 #include "driver/spi_master.h"
 #include "driver/gpio.h"
+#include "esp_heap_caps.h"
+#include <algorithm>
 #include "SPI.h"
 
 SPIClass::SPIClass(spi_host_device_t bus)
@@ -28,17 +30,25 @@ bool SPIClass::begin(uint8_t mosi, uint8_t miso, uint8_t sck, uint8_t cs)
         .sclk_io_num = sck,
         .quadwp_io_num = -1,
         .quadhd_io_num = -1,
-        .max_transfer_sz = 2048
+        .max_transfer_sz = SPI_MAX_TRANSFER
     };
 
     host_init = spi_bus_initialize(host, &buscfg, 2) == ESP_OK;
     device_cs = cs;
 
+    if (host_init && device_cs >= 0) {
+        gpio_set_direction((gpio_num_t)device_cs, GPIO_MODE_OUTPUT);
+        gpio_set_level((gpio_num_t)device_cs, 1);
+    }
+
     return host_init;
 }
 
 void SPIClass::end()
 {
+    if (in_transaction) {
+        endTransaction();
+    }
     if (spi != nullptr) {
         spi_bus_remove_device(spi);
         spi = nullptr;
@@ -47,41 +57,175 @@ void SPIClass::end()
         spi_bus_free(host);
         host_init = false;
     }
+    for (int i = 0; i < SPI_QUEUE_SIZE; i++) {
+        heap_caps_free(dma_buffer[i]);
+        dma_buffer[i] = nullptr;
+    }
+    heap_caps_free(polling_buffer);
+    polling_buffer = nullptr;
 }
 
-void SPIClass::beginTransaction(SPISettings settings)
+bool SPIClass::setDevice(const SPISettings &newSettings)
 {
-    /*
-    spi_device_interface_config_t devcfg = {
-        .mode = settings.dataMode,
-        .clock_speed_hz = settings.clock,
-        .spics_io_num = device_cs,
-        .queue_size = 7,
-        .pre_cb = nullptr,
-    };
+    if (spi != nullptr && settings == newSettings) {
+        return true;
+    }
+    if (spi != nullptr) {
+        spi_bus_remove_device(spi);
+        spi = nullptr;
+    }
 
-    if (spi_bus_add_device(host, &devcfg, &spi) != ESP_OK) {
-        // start transaction
-        memset(&transaction, 0, sizeof(transaction));
+    spi_device_interface_config_t devcfg = {};
+    devcfg.mode = (newSettings.dataMode >> 2) & 3; // SPI_MODEx to the IDF's 0-3
+    devcfg.clock_speed_hz = newSettings.clock;
+    devcfg.spics_io_num = -1;
+    devcfg.flags = (newSettings.bitOrder == LSBFIRST) ? (SPI_DEVICE_TXBIT_LSBFIRST | SPI_DEVICE_RXBIT_LSBFIRST) : 0;
+    devcfg.queue_size = SPI_QUEUE_SIZE;
+
+    if (!host_init || spi_bus_add_device(host, &devcfg, &spi) != ESP_OK) {
+        ESP_LOGE("SPI", "Failed to add the device");
+        spi = nullptr;
+        return false;
+    }
+    settings = newSettings;
+    return true;
+}
+
+void SPIClass::beginTransaction(SPISettings newSettings)
+{
+    if (in_transaction || !setDevice(newSettings)) {
+        return;
+    }
+    // Nobody else can use the bus until endTransaction(), which also allows polling transfers
+    spi_device_acquire_bus(spi, portMAX_DELAY);
+    if (device_cs >= 0) {
+        gpio_set_level((gpio_num_t)device_cs, 0);
     }
-    */
+    in_transaction = true;
 }
 
 void SPIClass::endTransaction(void)
 {
-    spi_device_transmit(spi, &transaction);
-    spi_bus_remove_device(spi);
-    spi = nullptr;
+    if (!in_transaction) {
+        return;
+    }
+    if (device_cs >= 0) {
+        gpio_set_level((gpio_num_t)device_cs, 1);
+    }
+    spi_device_release_bus(spi);
+    in_transaction = false;
+}
+
+// Short transfers: the data fits in the transaction itself when it can, no interrupt, no DMA setup.
+// Otherwise it is copied to an aligned DMA capable buffer, the driver would allocate one for every
+// transfer from a buffer that isn't.
+void SPIClass::transferPolling(uint8_t *buf, size_t count)
+{
+    spi_transaction_t t = {};
+    uint8_t *data = buf;
+    t.length = count * 8;
+    if (count <= 4) {
+        t.flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA;
+        memcpy(t.tx_data, buf, count);
+    } else {
+        if (polling_buffer == nullptr) {
+            polling_buffer = (uint8_t*)heap_caps_malloc(SPI_POLLING_MAX, MALLOC_CAP_DMA);
+        }
+        if (polling_buffer != nullptr && count <= SPI_POLLING_MAX) {
+            data = polling_buffer;
+            memcpy(data, buf, count);
+        }
+        t.tx_buffer = data;
+        t.rx_buffer = data; // Full duplex in place
+    }
+    if (spi_device_polling_transmit(spi, &t) == ESP_OK) {
+        if (count <= 4) {
+            memcpy(buf, t.rx_data, count);
+        } else if (data != buf) {
+            memcpy(buf, data, count);
+        }
+    }
+}
+
+// Long transfers: split in DMA chunks, the next one is queued while the previous one completes
+void SPIClass::transferQueued(uint8_t *buf, size_t count)
+{
+    spi_transaction_t t[SPI_QUEUE_SIZE] = {};
+    size_t offset[SPI_QUEUE_SIZE];
+    int inflight = 0;
+
+    for (int i = 0; i < SPI_QUEUE_SIZE; i++) {
+        if (dma_buffer[i] == nullptr) {
+            dma_buffer[i] = (uint8_t*)heap_caps_malloc(SPI_DMA_CHUNK, MALLOC_CAP_DMA);
+        }
+        if (dma_buffer[i] == nullptr) {
+            ESP_LOGE("SPI", "No DMA memory, falling back to polling");
+            for (size_t pos = 0; pos < count; pos += SPI_DMA_CHUNK) {
+                transferPolling(buf + pos, std::min((size_t)SPI_DMA_CHUNK, count - pos));
+            }
+            return;
+        }
+    }
+
+    for (size_t pos = 0, slot = 0; pos < count || inflight > 0; slot = (slot + 1) % SPI_QUEUE_SIZE) {
+        if (inflight == SPI_QUEUE_SIZE || (pos >= count && inflight > 0)) {
+            spi_transaction_t *done;
+            spi_device_get_trans_result(spi, &done, portMAX_DELAY);
+            int i = done - t;
+            memcpy(buf + offset[i], dma_buffer[i], done->length / 8);
+            inflight--;
+        }
+        if (pos < count) {
+            size_t len = std::min((size_t)SPI_DMA_CHUNK, count - pos);
+            memcpy(dma_buffer[slot], buf + pos, len);
+            t[slot] = {};
+            t[slot].length = len * 8;
+            t[slot].tx_buffer = dma_buffer[slot];
+            t[slot].rx_buffer = dma_buffer[slot];
+            offset[slot] = pos;
+            spi_device_queue_trans(spi, &t[slot], portMAX_DELAY);
+            inflight++;
+            pos += len;
+        }
+    }
+}
+
+uint16_t SPIClass::transfer16(uint16_t data)
+{
+    uint8_t buf[2] = {(uint8_t)(data >> 8), (uint8_t)data};
+    transfer(buf, 2);
+    return (buf[0] << 8) | buf[1];
 }
 
 uint8_t SPIClass::transfer(uint8_t data)
 {
-    return 0;
+    transfer(&data, 1);
+    return data;
 }
 
 void SPIClass::transfer(void *buf, size_t count)
 {
+    bool implicit = !in_transaction;
 
+    if (count == 0) {
+        return;
+    }
+    if (implicit) { // Arduino allows transfers outside of a transaction, with the last settings
+        beginTransaction(spi ? settings : SPISettings());
+        if (!in_transaction) {
+            return;
+        }
+    }
+
+    if (count <= SPI_POLLING_MAX) {
+        transferPolling((uint8_t*)buf, count);
+    } else {
+        transferQueued((uint8_t*)buf, count);
+    }
+
+    if (implicit) {
+        endTransaction();
+    }
 }
 
 void SPIClass::usingInterrupt(uint8_t interruptNumber)
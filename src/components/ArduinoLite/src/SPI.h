@@ -21,13 +21,22 @@
 #define SPI_MODE2 0x08
 #define SPI_MODE3 0x0C
 
+#define SPI_POLLING_MAX 32      // Bytes, shorter transfers busy-wait instead of paying for an interrupt
+#define SPI_DMA_CHUNK 1024      // Bytes per queued DMA transaction, two are in flight at once
+#define SPI_MAX_TRANSFER 2048
+#define SPI_QUEUE_SIZE 2
+
 class SPISettings
 {
   public:
     int clock;
     uint8_t bitOrder;
     uint8_t dataMode;
-    SPISettings(int clock = SPI_MASTER_FREQ_8M, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0) {}
+    SPISettings(int clock = SPI_MASTER_FREQ_8M, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0):
+        clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+    bool operator==(const SPISettings &other) const {
+        return clock == other.clock && bitOrder == other.bitOrder && dataMode == other.dataMode;
+    }
 };
 
 class SPIClass
@@ -35,9 +44,16 @@ class SPIClass
   private:
     spi_host_device_t host = VSPI_HOST;
     spi_device_handle_t spi = nullptr;
-    spi_transaction_t transaction;
+    SPISettings settings;           // The device is only re-added when they change
     bool host_init = false;
-    int  device_cs = -1;
+    bool in_transaction = false;
+    int  device_cs = -1;            // Driven by us for the whole transaction, not per queued chunk
+    uint8_t *dma_buffer[SPI_QUEUE_SIZE] = {};
+    uint8_t *polling_buffer = nullptr;  // SPI_POLLING_MAX bytes of DMA capable memory
+
+    bool setDevice(const SPISettings &settings);
+    void transferPolling(uint8_t *buf, size_t count);
+    void transferQueued(uint8_t *buf, size_t count);
   public:
     SPIClass(spi_host_device_t bus = VSPI_HOST);
     bool begin();
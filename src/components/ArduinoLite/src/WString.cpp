@@ -21,6 +21,108 @@
 
 #include "WString.h"
 
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+static portMUX_TYPE arena_lock = portMUX_INITIALIZER_UNLOCKED;
+#define ARENA_LOCK()   portENTER_CRITICAL(&arena_lock)
+#define ARENA_UNLOCK() portEXIT_CRITICAL(&arena_lock)
+#else
+#define ARENA_LOCK()
+#define ARENA_UNLOCK()
+#endif
+
+/*********************************************/
+/*  Arena                                    */
+/*********************************************/
+
+#if STRING_ARENA_SIZE > 0
+static char arena[STRING_ARENA_SIZE] __attribute__((aligned(4)));
+#else
+static char *arena = NULL;
+#endif
+static unsigned int arena_top = 0;   // First free byte
+static char *arena_last = NULL;      // Last block handed out, the only one that can grow or be released
+static string_arena_stats_t arena_stats;
+
+static inline bool inArena(const char *ptr)
+{
+	return STRING_ARENA_SIZE > 0 && ptr >= arena && ptr < arena + STRING_ARENA_SIZE;
+}
+
+// Resizes a block of oldSize bytes (0 for a new block) to size bytes, moving it if needed
+static char *arenaRealloc(char *ptr, unsigned int oldSize, unsigned int size)
+{
+	char *result = NULL;
+	size = (size + 3) & ~3;
+
+	if (STRING_ARENA_SIZE == 0) {
+		arena_stats.heap_allocations++;
+		return (char *)realloc(ptr, size);
+	}
+
+	ARENA_LOCK();
+	if (ptr && ptr == arena_last && (ptr - arena) + size <= STRING_ARENA_SIZE) {
+		arena_top = (ptr - arena) + size; // Grow (or shrink) in place
+		result = ptr;
+	} else if (arena_top + size <= STRING_ARENA_SIZE) {
+		result = arena_last = arena + arena_top;
+		arena_top += size;
+		arena_stats.allocations++;
+	}
+	if (arena_top > arena_stats.peak) arena_stats.peak = arena_top;
+	ARENA_UNLOCK();
+
+	if (result == NULL && !inArena(ptr)) {
+		arena_stats.heap_allocations++;
+		return (char *)realloc(ptr, size);
+	}
+	if (result == NULL) {
+		arena_stats.heap_allocations++;
+		result = (char *)malloc(size);
+	}
+	if (result && ptr && result != ptr) {
+		memcpy(result, ptr, oldSize < size ? oldSize : size);
+		if (!inArena(ptr)) free(ptr);
+		else if (ptr == arena_last && !inArena(result)) { // Moved out of the arena, give the space back
+			ARENA_LOCK();
+			arena_top = ptr - arena;
+			arena_last = NULL;
+			ARENA_UNLOCK();
+		}
+	}
+	return result;
+}
+
+static void arenaFree(char *ptr)
+{
+	if (!inArena(ptr)) {
+		free(ptr);
+		return;
+	}
+	ARENA_LOCK();
+	if (ptr == arena_last) {
+		arena_top = ptr - arena;
+		arena_last = NULL;
+	}
+	ARENA_UNLOCK();
+}
+
+void String::resetArena(void)
+{
+	ARENA_LOCK();
+	arena_top = 0;
+	arena_last = NULL;
+	arena_stats = string_arena_stats_t();
+	ARENA_UNLOCK();
+}
+
+string_arena_stats_t String::arenaStats(void)
+{
+	string_arena_stats_t stats = arena_stats;
+	stats.used = arena_top;
+	return stats;
+}
+
 char * dtostrf(double val, signed char width, unsigned char prec, char * s)
 {
     char format[8];
@@ -129,7 +231,7 @@ String::String(double value, unsigned char decimalPlaces)
 
 String::~String()
 {
-	free(buffer);
+	arenaFree(buffer);
 }
 
 /*********************************************/
@@ -145,7 +247,7 @@ inline void String::init(void)
 
 void String::invalidate(void)
 {
-	if (buffer) free(buffer);
+	if (buffer) arenaFree(buffer);
 	buffer = NULL;
 	capacity = len = 0;
 }
@@ -162,7 +264,7 @@ unsigned char String::reserve(unsigned int size)
 
 unsigned char String::changeBuffer(unsigned int maxStrLen)
 {
-	char *newbuffer = (char *)realloc(buffer, maxStrLen + 1);
+	char *newbuffer = arenaRealloc(buffer, buffer ? capacity + 1 : 0, maxStrLen + 1);
 	if (newbuffer) {
 		buffer = newbuffer;
 		capacity = maxStrLen;
@@ -196,7 +298,7 @@ void String::move(String &rhs)
 			rhs.len = 0;
 			return;
 		} else {
-			free(buffer);
+			arenaFree(buffer);
 		}
 	}
 	buffer = rhs.buffer;
@@ -39,6 +39,21 @@ char* ultoa (unsigned long val, char *s, int radix);
 //     -felide-constructors
 //     -std=c++0x
 
+// Opt-in: with a size, String buffers are carved from a static arena first and only go to the heap
+// when it is full. Freeing only gives memory back when it is the last block, so a project enabling it
+// needs a point where no String is alive anymore (e.g. the end of a request) to call resetArena().
+// 0 (the default) always uses the heap and costs no memory.
+#ifndef STRING_ARENA_SIZE
+#define STRING_ARENA_SIZE 0
+#endif
+
+typedef struct {
+	unsigned int allocations;      // Blocks taken from the arena
+	unsigned int heap_allocations; // malloc/realloc calls, because the arena was full or disabled
+	unsigned int used;             // Arena bytes in use
+	unsigned int peak;
+} string_arena_stats_t;
+
 class __FlashStringHelper;
 #define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
 
@@ -197,6 +212,9 @@ public:
 	float toFloat(void) const;
 	double toDouble(void) const;
 
+	static void resetArena(void);
+	static string_arena_stats_t arenaStats(void);
+
 protected:
 	char *buffer;	        // the actual char array
 	unsigned int capacity;  // the array length minus one (for the '\0')
@@ -7,6 +7,49 @@ TwoWire::TwoWire(int8_t num):
 TwoWire::~TwoWire()
 {
     end();
+#if WIRE_STATIC_LINK
+    free(linkBuffer);
+    free(batchLinkBuffer);
+#endif
+}
+
+
+// Transmissions and batches have their own buffer, each sized for its use
+i2c_cmd_handle_t TwoWire::createLink(bool forBatch)
+{
+#if WIRE_STATIC_LINK
+    uint8_t *&buffer = forBatch ? batchLinkBuffer : linkBuffer;
+    size_t size = forBatch ? WIRE_BATCH_LINK_SIZE : WIRE_LINK_SIZE;
+    if (buffer == nullptr) {
+        buffer = (uint8_t*)malloc(size);
+    }
+    return i2c_cmd_link_create_static(buffer, size);
+#else
+    return i2c_cmd_link_create();
+#endif
+}
+
+
+esp_err_t TwoWire::runLink(i2c_cmd_handle_t link, uint32_t clock)
+{
+    if (busLock) xSemaphoreTake(busLock, portMAX_DELAY);
+    configure(clock);
+#if WIRE_MOCK_BUS
+    // 9 clocks per byte plus start and stop
+    delayMicroseconds(WIRE_MOCK_OVERHEAD_US + (mockBytes * 9 + 2) * 1000000 / currentClock);
+    mockBytes = 0;
+    esp_err_t err = ESP_OK;
+#else
+    TickType_t ticks = timeoutMs / portTICK_RATE_MS;
+    esp_err_t err = i2c_master_cmd_begin(num, link, ticks > 0 ? ticks : 1);
+#endif
+#if WIRE_STATIC_LINK
+    i2c_cmd_link_delete_static(link);
+#else
+    i2c_cmd_link_delete(link);
+#endif
+    if (busLock) xSemaphoreGive(busLock);
+    return err;
 }
 
 bool TwoWire::begin()
@@ -17,20 +60,44 @@ bool TwoWire::begin()
     return init;
 }
 
-bool TwoWire::begin(int sdaPin, int sclPin)
+bool TwoWire::configure(uint32_t clock)
 {
-    end(); // Clear the previous driver
-    sda = (gpio_num_t)sdaPin;
-    scl = (gpio_num_t)sclPin;
-    i2c_config_t conf;
+    if (clock == currentClock) {
+        return true;
+    }
+    i2c_config_t conf = {};
     conf.mode = I2C_MODE_MASTER;
     conf.sda_io_num = sda;
     conf.scl_io_num = scl;
     conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
     conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
-    conf.master.clk_speed = 200000;
-    i2c_param_config(num, &conf);
-    init = (i2c_driver_install(num, conf.mode, 0, 0, 0) == ESP_OK);
+    conf.master.clk_speed = clock;
+#if WIRE_MOCK_BUS
+    (void)conf;
+#else
+    if (i2c_param_config(num, &conf) != ESP_OK) {
+        ESP_LOGE("I2C", "Failed to set the clock to %u Hz", clock);
+        return false;
+    }
+#endif
+    currentClock = clock;
+    return true;
+}
+
+bool TwoWire::begin(int sdaPin, int sclPin)
+{
+    end(); // Clear the previous driver
+    if (busLock == nullptr) {
+        busLock = xSemaphoreCreateMutex();
+    }
+    sda = (gpio_num_t)sdaPin;
+    scl = (gpio_num_t)sclPin;
+    currentClock = 0;
+#if WIRE_MOCK_BUS
+    init = configure(busClock);
+#else
+    init = configure(busClock) && (i2c_driver_install(num, I2C_MODE_MASTER, 0, 0, 0) == ESP_OK);
+#endif
     if (!init) {
         ESP_LOGE("I2C", "Failed to start the i2c driver");
     }
@@ -40,45 +107,104 @@ bool TwoWire::begin(int sdaPin, int sclPin)
 void TwoWire::end(void)
 {
     if (init == true) {
+#if !WIRE_MOCK_BUS
         i2c_driver_delete(num);
+#endif
         init = false;
     }
 }
 
 void TwoWire::setClock(uint32_t frequency)
 {
-    //i2cSetFrequency(i2c, frequency);
+    busClock = frequency;
+}
+
+bool TwoWire::setDeviceClock(uint8_t address, uint32_t frequency)
+{
+    int slot = -1;
+    for (int i = 0; i < WIRE_DEVICE_CLOCKS; i++) {
+        if (deviceClocks[i].address == address || (slot < 0 && deviceClocks[i].clock == 0)) {
+            slot = i;
+        }
+    }
+    if (slot < 0 || frequency > 1000000) {
+        return false;
+    }
+    deviceClocks[slot].address = address;
+    deviceClocks[slot].clock = frequency;
+    return true;
+}
+
+uint32_t TwoWire::deviceClock(uint8_t address)
+{
+    for (int i = 0; i < WIRE_DEVICE_CLOCKS; i++) {
+        if (deviceClocks[i].address == address && deviceClocks[i].clock > 0) {
+            return deviceClocks[i].clock;
+        }
+    }
+    return busClock;
+}
+
+bool TwoWire::probe(uint8_t address, uint32_t timeout_ms)
+{
+    uint32_t saved = timeoutMs;
+    timeoutMs = timeout_ms;
+    beginTransmission(address);
+    uint8_t err = endTransmission();
+    timeoutMs = saved;
+    return err == 0;
 }
 
 void TwoWire::beginTransmission(int address, i2c_rw_t type)
 {
-    cmd = i2c_cmd_link_create();
+    txAddress = address;
+    if (batch != nullptr) {
+        ESP_LOGE("I2C", "Transmission to 0x%02x rejected, a batch is open", address);
+        cmd = nullptr;
+        return;
+    }
+    cmd = createLink(false);
     i2c_master_start(cmd);
     i2c_master_write_byte(cmd, (address << 1) | type, true);
+#if WIRE_MOCK_BUS
+    mockBytes++;
+#endif
 }
 
 uint8_t TwoWire::endTransmission(bool sendStop)
 {
+    esp_err_t err = ESP_ERR_INVALID_STATE;
     if (cmd != nullptr) {
         i2c_master_stop(cmd);
-        i2c_master_cmd_begin(num, cmd, 1000 / portTICK_RATE_MS);
-        i2c_cmd_link_delete(cmd);
+        err = runLink(cmd, deviceClock(txAddress));
     }
     cmd = nullptr;
-    return 0;
+
+    switch (err) {
+        case ESP_OK:          return 0;
+        case ESP_FAIL:        return 2; // NACK
+        case ESP_ERR_TIMEOUT: return 5;
+        default:              return 4;
+    }
 }
 
 uint8_t TwoWire::requestFrom(int address, size_t size, bool sendStop)
 {
     beginTransmission(address, I2C_MASTER_READ);
+    if (cmd == nullptr) {
+        endTransmission();
+        return rxCount = rxIndex = 0;
+    }
     if (size > 1) {
         i2c_master_read(cmd, rxBuffer, size - 1, I2C_MASTER_ACK);
     }
     i2c_master_read(cmd, rxBuffer + (size - 1), 1, I2C_MASTER_NACK);
-    endTransmission();
-    rxCount = size;
+#if WIRE_MOCK_BUS
+    mockBytes += size;
+#endif
+    rxCount = (endTransmission() == 0) ? size : 0;
     rxIndex = 0;
-    return size;
+    return rxCount;
 }
 
 int TwoWire::available(void)
@@ -98,14 +224,243 @@ int TwoWire::peek(void)
 
 size_t TwoWire::write(uint8_t data)
 {
+    if (cmd == nullptr) {
+        return 0;
+    }
+#if WIRE_MOCK_BUS
+    mockBytes++;
+#endif
     return (i2c_master_write_byte(cmd, data, true) == ESP_OK) ? 1 : 0;
 }
 
 size_t TwoWire::write(const uint8_t* data, size_t size)
 {
+    if (cmd == nullptr) {
+        return 0;
+    }
+#if WIRE_MOCK_BUS
+    mockBytes += size;
+#endif
     return (i2c_master_write(cmd, (uint8_t*)data, size, true) == ESP_OK) ? size : 0;
 }
 
 
+// Operations are separated by repeated starts, which any device can tell apart
+void TwoWire::beginBatch()
+{
+    if (batch == nullptr) {
+        batch = createLink(true);
+        batchClock = 0;
+    }
+}
+
+bool TwoWire::batchWrite(uint8_t address, uint8_t reg, const uint8_t* data, size_t size)
+{
+    if (batch == nullptr) {
+        return false;
+    }
+    // The batch runs at the speed of its slowest device
+    if (batchClock == 0 || deviceClock(address) < batchClock) batchClock = deviceClock(address);
+    bool ok = i2c_master_start(batch) == ESP_OK
+           && i2c_master_write_byte(batch, (address << 1) | I2C_MASTER_WRITE, true) == ESP_OK
+           && i2c_master_write_byte(batch, reg, true) == ESP_OK
+           && (size == 0 || i2c_master_write(batch, (uint8_t*)data, size, true) == ESP_OK);
+#if WIRE_MOCK_BUS
+    mockBytes += 2 + size;
+#endif
+    return ok;
+}
+
+bool TwoWire::batchRead(uint8_t address, uint8_t reg, uint8_t* data, size_t size)
+{
+    if (batch == nullptr || size == 0) {
+        return false;
+    }
+    if (batchClock == 0 || deviceClock(address) < batchClock) batchClock = deviceClock(address);
+    // Register address then a repeated start to read
+    bool ok = i2c_master_start(batch) == ESP_OK
+           && i2c_master_write_byte(batch, (address << 1) | I2C_MASTER_WRITE, true) == ESP_OK
+           && i2c_master_write_byte(batch, reg, true) == ESP_OK
+           && i2c_master_start(batch) == ESP_OK
+           && i2c_master_write_byte(batch, (address << 1) | I2C_MASTER_READ, true) == ESP_OK
+           && i2c_master_read(batch, data, size, I2C_MASTER_LAST_NACK) == ESP_OK;
+#if WIRE_MOCK_BUS
+    mockBytes += 3 + size;
+#endif
+    return ok;
+}
+
+esp_err_t TwoWire::endBatch()
+{
+    if (batch == nullptr) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    i2c_master_stop(batch);
+    esp_err_t err = runLink(batch, batchClock ? batchClock : busClock);
+    batch = nullptr;
+    return err;
+}
+
+
+// A single transaction on behalf of the job task. It builds its link in its own buffer so that
+// it can't clobber a transmission that the synchronous API is building at the same time.
+// That buffer is a member, WIRE_LINK_SIZE would not fit on the job task's stack.
+esp_err_t TwoWire::transfer(uint8_t address, const uint8_t *tx, size_t txSize, int reg, uint8_t *rx, size_t rxSize)
+{
+#if WIRE_STATIC_LINK
+    i2c_cmd_handle_t link = i2c_cmd_link_create_static(jobLinkBuffer, WIRE_JOB_LINK_SIZE);
+#else
+    i2c_cmd_handle_t link = i2c_cmd_link_create();
+#endif
+    i2c_master_start(link);
+    if (txSize > 0 || reg >= 0) {
+        i2c_master_write_byte(link, (address << 1) | I2C_MASTER_WRITE, true);
+        if (txSize > 0) i2c_master_write(link, (uint8_t*)tx, txSize, true);
+        if (reg >= 0) i2c_master_write_byte(link, (uint8_t)reg, true);
+        if (rxSize > 0) i2c_master_start(link);
+    }
+    if (rxSize > 0) {
+        i2c_master_write_byte(link, (address << 1) | I2C_MASTER_READ, true);
+        i2c_master_read(link, rx, rxSize, I2C_MASTER_LAST_NACK);
+    }
+    i2c_master_stop(link);
+#if WIRE_MOCK_BUS
+    mockBytes += 1 + txSize + (reg >= 0) + (rxSize > 0 ? 1 + rxSize : 0);
+#endif
+    return runLink(link, deviceClock(address));
+}
+
+void TwoWire::jobTaskMain(void *arg)
+{
+    ((TwoWire*)arg)->runJobs();
+}
+
+void TwoWire::finishJob(WireJob *job, esp_err_t status)
+{
+    job->status = status;
+    if (job->callback) {
+        job->callback(job);
+    }
+    TaskHandle_t waiter = __atomic_load_n(&job->waiter, __ATOMIC_SEQ_CST);
+    job->done = true; // Last, the owner may release the job as soon as it sees it
+    if (waiter) {
+        xTaskNotifyGive(waiter);
+    }
+}
+
+// Writes the job's command, then reads right away or puts it on the running list until its delay expires
+bool TwoWire::startJob(WireJob *job)
+{
+    for (WireJob *j = jobsRunning; j; j = j->next) {
+        if (j->address == job->address) {
+            return false; // The device is busy
+        }
+    }
+    if (job->delayMs == 0) {
+        finishJob(job, transfer(job->address, job->tx, job->txSize, job->rxReg, job->rx, job->rxSize));
+        return true;
+    }
+    esp_err_t err = (job->txSize > 0) ? transfer(job->address, job->tx, job->txSize, -1, nullptr, 0) : ESP_OK;
+    if (err != ESP_OK) {
+        finishJob(job, err);
+        return true;
+    }
+    job->due = millis() + job->delayMs;
+    job->next = jobsRunning;
+    jobsRunning = job;
+    return true;
+}
+
+void TwoWire::runJobs()
+{
+    WireJob **tail = &jobsPending;
+    WireJob *job;
+
+    while (true) {
+        TickType_t timeout = portMAX_DELAY;
+        if (jobsRunning) {
+            unsigned long now = millis(), due = jobsRunning->due;
+            for (WireJob *j = jobsRunning; j; j = j->next) {
+                if ((long)(j->due - due) < 0) due = j->due;
+            }
+            timeout = ((long)(due - now) > 0) ? (due - now) / portTICK_PERIOD_MS + 1 : 0;
+        }
+
+        // Drain the queue to keep the submission order
+        while (xQueueReceive(jobQueue, &job, timeout) == pdTRUE) {
+            job->next = nullptr;
+            *tail = job;
+            tail = &job->next;
+            timeout = 0;
+        }
+
+        // Collect the conversions that are done
+        for (WireJob **j = &jobsRunning; *j; ) {
+            job = *j;
+            if ((long)(millis() - job->due) >= 0) {
+                *j = job->next;
+                finishJob(job, job->rxSize > 0 ? transfer(job->address, nullptr, 0, job->rxReg, job->rx, job->rxSize) : ESP_OK);
+            } else {
+                j = &job->next;
+            }
+        }
+
+        // Start everything whose device is free, in order. A job behind a busy device waits for it,
+        // and so do the later jobs for that same device.
+        uint8_t busy[WIRE_JOB_QUEUE];
+        int busyCount = 0;
+        tail = &jobsPending;
+        for (WireJob **j = &jobsPending; *j; ) {
+            job = *j;
+            bool blocked = false;
+            for (int i = 0; i < busyCount; i++) {
+                blocked |= (busy[i] == job->address);
+            }
+            WireJob *next = job->next;
+            if (!blocked && startJob(job)) {
+                *j = next;
+            } else {
+                if (busyCount < WIRE_JOB_QUEUE) busy[busyCount++] = job->address;
+                j = &job->next;
+                tail = &job->next;
+            }
+        }
+    }
+}
+
+bool TwoWire::queue(WireJob *job)
+{
+    if (!init) {
+        job->status = ESP_ERR_INVALID_STATE;
+        job->done = true;
+        return false;
+    }
+    if (jobTask == nullptr) {
+        jobQueue = xQueueCreate(WIRE_JOB_QUEUE, sizeof(WireJob*));
+        xTaskCreate(&jobTaskMain, "i2c_jobs", WIRE_JOB_TASK_STACK, this, WIRE_JOB_TASK_PRIO, &jobTask);
+    }
+    job->done = false;
+    job->status = ESP_ERR_INVALID_STATE;
+    job->waiter = nullptr;
+    return xQueueSend(jobQueue, &job, portMAX_DELAY) == pdTRUE;
+}
+
+esp_err_t TwoWire::wait(WireJob *job, uint32_t timeout_ms)
+{
+    // Sleeps until finishJob() notifies us. If the job finishes before it sees our handle
+    // the notification is missed and we only lose one tick.
+    __atomic_store_n(&job->waiter, xTaskGetCurrentTaskHandle(), __ATOMIC_SEQ_CST);
+    unsigned long start = millis();
+    while (!job->done) {
+        if (millis() - start >= timeout_ms) {
+            __atomic_store_n(&job->waiter, (TaskHandle_t)nullptr, __ATOMIC_SEQ_CST);
+            return ESP_ERR_TIMEOUT;
+        }
+        ulTaskNotifyTake(pdTRUE, 1);
+    }
+    return job->status;
+}
+
+
 TwoWire Wire = TwoWire(0);
 TwoWire Wire1 = TwoWire(1);
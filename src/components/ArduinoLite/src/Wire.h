@@ -3,8 +3,59 @@
 
 #include "Arduino.h"
 #include "driver/i2c.h"
+#include "esp_idf_version.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "Stream.h"
 
+// Simulate the bus instead of using the driver (for benchmarks), transfers take the time they would at the bus speed
+#ifndef WIRE_MOCK_BUS
+#define WIRE_MOCK_BUS 0
+#endif
+#define WIRE_MOCK_OVERHEAD_US 30 // Estimated cost of one i2c_master_cmd_begin() besides the transfer itself
+
+#define WIRE_DEFAULT_CLOCK 200000
+#define WIRE_DEFAULT_TIMEOUT_MS 1000
+#define WIRE_PROBE_TIMEOUT_MS 10 // Only a stuck bus takes that long, a missing device NACKs right away
+#define WIRE_DEVICE_CLOCKS 8
+
+#define WIRE_JOB_BUFFER 8       // Bytes a job can write or read
+#define WIRE_JOB_QUEUE 16       // Jobs that can be queued before queue() blocks
+#define WIRE_JOB_TASK_STACK 3072
+#define WIRE_JOB_TASK_PRIO 5    // Above the main task so that conversions start as soon as they are queued
+
+// Command links are built in buffers reused by every transaction when the IDF supports it
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 4, 0)
+#define WIRE_STATIC_LINK 1
+#define WIRE_LINK_SIZE I2C_LINK_RECOMMENDED_SIZE(4)       // A transmission, up to ~20 single byte write() calls
+#define WIRE_BATCH_LINK_SIZE I2C_LINK_RECOMMENDED_SIZE(8) // Up to 8 batchRead() or batchWrite() operations
+#define WIRE_JOB_LINK_SIZE I2C_LINK_RECOMMENDED_SIZE(2)   // A job is one write and one read
+#else
+#define WIRE_STATIC_LINK 0
+#endif
+
+// Asynchronous job: write tx[] to the device, wait delayMs (a conversion), then read rxSize bytes.
+// Jobs on different devices overlap, jobs on the same device run in the order they were queued.
+struct WireJob {
+    uint8_t address;
+    uint8_t tx[WIRE_JOB_BUFFER];    // Usually a register followed by a command
+    uint8_t txSize;
+    uint16_t delayMs;
+    int16_t rxReg;                  // Register to read from (with a repeated start), -1 to read directly
+    uint8_t rx[WIRE_JOB_BUFFER];
+    uint8_t rxSize;
+    void (*callback)(WireJob *job); // Called from the I2C task when the job is done, may be NULL
+    void *arg;
+    TaskHandle_t waiter;            // Task blocked in wait(), notified when the job is done
+    // Owned by the I2C task
+    volatile bool done;
+    volatile esp_err_t status;
+    unsigned long due;
+    WireJob *next;
+};
+
 class TwoWire: public Stream
 {
   private:
@@ -12,7 +63,41 @@ class TwoWire: public Stream
     gpio_num_t sda = GPIO_NUM_MAX;
     gpio_num_t scl = GPIO_NUM_MAX;
     i2c_cmd_handle_t cmd = nullptr;
+    i2c_cmd_handle_t batch = nullptr;
+    uint32_t batchClock = 0;
     bool init = false;
+    uint32_t busClock = WIRE_DEFAULT_CLOCK;     // Used by devices without their own clock
+    uint32_t currentClock = 0;                  // What the controller is set to
+    uint32_t timeoutMs = WIRE_DEFAULT_TIMEOUT_MS;
+    uint8_t txAddress = 0;
+    struct {
+        uint8_t address;
+        uint32_t clock;
+    } deviceClocks[WIRE_DEVICE_CLOCKS] = {};
+#if WIRE_STATIC_LINK
+    uint8_t *linkBuffer = nullptr;      // cmd
+    uint8_t *batchLinkBuffer = nullptr; // batch
+    uint8_t jobLinkBuffer[WIRE_JOB_LINK_SIZE]; // Only used by the job task
+#endif
+#if WIRE_MOCK_BUS
+    size_t mockBytes = 0;
+#endif
+    SemaphoreHandle_t busLock = nullptr;  // Taken by the job task and the synchronous API
+    QueueHandle_t jobQueue = nullptr;
+    TaskHandle_t jobTask = nullptr;
+    WireJob *jobsPending = nullptr;       // Waiting for their device to be free
+    WireJob *jobsRunning = nullptr;       // Written, waiting for their delay to expire
+
+    static void jobTaskMain(void *arg);
+    void runJobs();
+    bool startJob(WireJob *job);
+    void finishJob(WireJob *job, esp_err_t status);
+    esp_err_t transfer(uint8_t address, const uint8_t *tx, size_t txSize, int reg, uint8_t *rx, size_t rxSize);
+
+    i2c_cmd_handle_t createLink(bool forBatch);
+    esp_err_t runLink(i2c_cmd_handle_t link, uint32_t clock);
+    uint32_t deviceClock(uint8_t address);
+    bool configure(uint32_t clock);
 
     uint8_t rxBuffer[128];
     uint8_t rxIndex = 0;
@@ -23,13 +108,18 @@ class TwoWire: public Stream
     ~TwoWire();
     bool begin();
     bool begin(int sda, int scl);
-    void setClock(uint32_t);
+    void setClock(uint32_t frequency);
+    bool setDeviceClock(uint8_t address, uint32_t frequency); // Up to 1 MHz, 0 to use the bus clock
+    void setBusTimeout(uint32_t ms) { timeoutMs = ms; }
+    bool probe(uint8_t address, uint32_t timeout_ms = WIRE_PROBE_TIMEOUT_MS);
     void end(void);
 
     // void onReceive(void (*)(int));
     // void onRequest(void (*)(void));
 
+    // Rejected while a batch is open, endTransmission() then fails with 4
     void beginTransmission(int address, i2c_rw_t type = I2C_MASTER_WRITE);
+    // Returns 0: success, 2: NACK (the IDF doesn't tell address and data apart), 4: other error, 5: timeout
     uint8_t endTransmission(bool sendStop = true);
     uint8_t requestFrom(int address, size_t size, bool sendStop = true);
 
@@ -42,6 +132,18 @@ class TwoWire: public Stream
     size_t write(const char* str) { return write((uint8_t*)str, strlen(str)); }
     size_t write(int data) { return write((uint8_t)data); }
     using Print::write;
+
+    // Batched transactions, every operation is queued then executed with a single i2c_master_cmd_begin()
+    // Buffers given to batchRead() and batchWrite() must stay valid until endBatch()
+    void beginBatch();
+    bool batchWrite(uint8_t address, uint8_t reg, const uint8_t* data, size_t size);
+    bool batchRead(uint8_t address, uint8_t reg, uint8_t* data, size_t size);
+    esp_err_t endBatch();
+
+    // Asynchronous jobs, run by a dedicated task. The job must stay valid until it is done.
+    bool queue(WireJob *job);
+    esp_err_t wait(WireJob *job, uint32_t timeout_ms = WIRE_DEFAULT_TIMEOUT_MS);
+    static bool done(const WireJob *job) { return job->done; }
 };
 
 extern TwoWire Wire;
@@ -17,7 +17,7 @@ static bool writeReg(uint8_t i2c_address, uint8_t reg, uint8_t val)
     Wire.beginTransmission(i2c_address);
     Wire.write(reg);
     if (val > 0) Wire.write(val);
-    return Wire.endTransmission() > 0;
+    return Wire.endTransmission() == 0;
 }
 
 
@@ -34,6 +34,9 @@ static uint16_t readInt(uint8_t i2c_address, uint8_t reg, uint8_t size)
 }
 
 
+static const uint8_t pressureDelays[] = {5, 8, 14, 26}; // ms, by oversampling
+
+
 static uint16_t readRawTemperature(bmp180_dev_t *dev)
 {
     writeReg(dev->i2c_address, BMP180_REG_CONTROL, BMP180_CMD_READTEMP);
@@ -49,11 +52,14 @@ static uint32_t readRawPressure(bmp180_dev_t *dev)
     writeReg(dev->i2c_address, BMP180_REG_CONTROL,
         (uint8_t)(BMP180_CMD_READPRESSURE + (dev->oversampling << 6)));
 
-    uint8_t delays[] = {5, 8, 14, 26};
-    delay(delays[dev->oversampling % 4]);
+    delay(pressureDelays[dev->oversampling % 4]);
+
+    uint8_t data[3] = {0};
+    Wire.beginBatch();
+    Wire.batchRead(dev->i2c_address, BMP180_REG_RESULT, data, sizeof(data));
+    Wire.endBatch();
 
-    raw = (readInt(dev->i2c_address, BMP180_REG_RESULT, 2) << 8)
-            | readInt(dev->i2c_address, BMP180_REG_RESULT + 2, 1);
+    raw = (data[0] << 16) | (data[1] << 8) | data[2];
     raw >>= (8 - dev->oversampling);
 
     return raw;
@@ -62,7 +68,17 @@ static uint32_t readRawPressure(bmp180_dev_t *dev)
 
 bmp180_dev_t* BMP180_init(uint8_t i2c_address, uint8_t oversampling)
 {
-    if (!Wire.begin() || readInt(i2c_address, BMP180_CMD_WHO_AM_I, 1) != 0x55) {
+    uint8_t who = 0, cal[22];
+
+    if (!Wire.begin()) {
+        return NULL;
+    }
+
+    /* read the chip id and the whole calibration block in a single bus transaction */
+    Wire.beginBatch();
+    Wire.batchRead(i2c_address, BMP180_CMD_WHO_AM_I, &who, 1);
+    Wire.batchRead(i2c_address, BMP180_CAL_AC1, cal, sizeof(cal));
+    if (Wire.endBatch() != ESP_OK || who != 0x55) {
         return NULL;
     }
 
@@ -71,18 +87,19 @@ bmp180_dev_t* BMP180_init(uint8_t i2c_address, uint8_t oversampling)
     dev->i2c_address = i2c_address;
     dev->oversampling = oversampling;
 
-    /* read calibration data */
-    dev->ac1 = readInt(i2c_address, BMP180_CAL_AC1, 2);
-    dev->ac2 = readInt(i2c_address, BMP180_CAL_AC2, 2);
-    dev->ac3 = readInt(i2c_address, BMP180_CAL_AC3, 2);
-    dev->ac4 = readInt(i2c_address, BMP180_CAL_AC4, 2);
-    dev->ac5 = readInt(i2c_address, BMP180_CAL_AC5, 2);
-    dev->ac6 = readInt(i2c_address, BMP180_CAL_AC6, 2);
-    dev->b1 = readInt(i2c_address, BMP180_CAL_B1, 2);
-    dev->b2 = readInt(i2c_address, BMP180_CAL_B2, 2);
-    dev->mb = readInt(i2c_address, BMP180_CAL_MB, 2);
-    dev->mc = readInt(i2c_address, BMP180_CAL_MC, 2);
-    dev->md = readInt(i2c_address, BMP180_CAL_MD, 2);
+    #define CAL16(reg) ((cal[(reg) - BMP180_CAL_AC1] << 8) | cal[(reg) - BMP180_CAL_AC1 + 1])
+    dev->ac1 = CAL16(BMP180_CAL_AC1);
+    dev->ac2 = CAL16(BMP180_CAL_AC2);
+    dev->ac3 = CAL16(BMP180_CAL_AC3);
+    dev->ac4 = CAL16(BMP180_CAL_AC4);
+    dev->ac5 = CAL16(BMP180_CAL_AC5);
+    dev->ac6 = CAL16(BMP180_CAL_AC6);
+    dev->b1 = CAL16(BMP180_CAL_B1);
+    dev->b2 = CAL16(BMP180_CAL_B2);
+    dev->mb = CAL16(BMP180_CAL_MB);
+    dev->mc = CAL16(BMP180_CAL_MC);
+    dev->md = CAL16(BMP180_CAL_MD);
+    #undef CAL16
 
     if (!(dev->ac1 && dev->ac2 && dev->ac3 && dev->ac4 && dev->ac5 && dev->ac6)) {
         free(dev);
@@ -93,13 +110,11 @@ bmp180_dev_t* BMP180_init(uint8_t i2c_address, uint8_t oversampling)
 }
 
 
-float BMP180_readTemperature(bmp180_dev_t *dev)
+static float computeTemperature(bmp180_dev_t *dev, int32_t UT)
 {
-    int32_t UT, X1, X2, B5;     // following ds convention
+    int32_t X1, X2, B5;     // following ds convention
     float temp;
 
-    UT = readRawTemperature(dev);
-
     X1 = (UT - (int32_t)dev->ac6) * ((int32_t)dev->ac5) >> 15;
     X2 = ((int32_t)dev->mc << 11) / (X1+(int32_t)dev->md);
     B5 = X1 + X2;
@@ -110,14 +125,11 @@ float BMP180_readTemperature(bmp180_dev_t *dev)
 }
 
 
-float BMP180_readPressure(bmp180_dev_t *dev)
+static float computePressure(bmp180_dev_t *dev, int32_t UT, int32_t UP)
 {
-    int32_t UT, UP, B3, B5, B6, X1, X2, X3, p;
+    int32_t B3, B5, B6, X1, X2, X3, p;
     uint32_t B4, B7;
 
-    UT = readRawTemperature(dev);
-    UP = readRawPressure(dev);
-
     X1 = (UT - (int32_t)dev->ac6) * ((int32_t)dev->ac5) >> 15;
     X2 = ((int32_t)dev->mc << 11) / (X1+(int32_t)dev->md);
     B5 = X1 + X2;
@@ -150,6 +162,65 @@ float BMP180_readPressure(bmp180_dev_t *dev)
 }
 
 
+float BMP180_readTemperature(bmp180_dev_t *dev)
+{
+    return computeTemperature(dev, readRawTemperature(dev));
+}
+
+
+float BMP180_readPressure(bmp180_dev_t *dev)
+{
+    int32_t UT = readRawTemperature(dev);
+    int32_t UP = readRawPressure(dev);
+    return computePressure(dev, UT, UP);
+}
+
+
+bool BMP180_startRead(bmp180_dev_t *dev)
+{
+    WireJob *temp = &dev->jobs[0], *pres = &dev->jobs[1];
+
+    memset(dev->jobs, 0, sizeof(dev->jobs));
+    temp->address = pres->address = dev->i2c_address;
+    temp->rxReg = pres->rxReg = BMP180_REG_RESULT;
+    temp->txSize = pres->txSize = 2;
+    temp->tx[0] = pres->tx[0] = BMP180_REG_CONTROL;
+
+    temp->tx[1] = BMP180_CMD_READTEMP;
+    temp->delayMs = 5;
+    temp->rxSize = 2;
+
+    pres->tx[1] = (uint8_t)(BMP180_CMD_READPRESSURE + (dev->oversampling << 6));
+    pres->delayMs = pressureDelays[dev->oversampling % 4];
+    pres->rxSize = 3;
+
+    return Wire.queue(temp) && Wire.queue(pres);
+}
+
+
+bool BMP180_readReady(bmp180_dev_t *dev)
+{
+    return Wire.done(&dev->jobs[0]) && Wire.done(&dev->jobs[1]);
+}
+
+
+bool BMP180_finishRead(bmp180_dev_t *dev, float *temperature, float *pressure)
+{
+    const uint8_t *t = dev->jobs[0].rx, *p = dev->jobs[1].rx;
+
+    if (!BMP180_readReady(dev) || dev->jobs[0].status != ESP_OK || dev->jobs[1].status != ESP_OK) {
+        return false;
+    }
+
+    int32_t UT = (t[0] << 8) | t[1];
+    int32_t UP = ((p[0] << 16) | (p[1] << 8) | p[2]) >> (8 - dev->oversampling);
+
+    *temperature = computeTemperature(dev, UT);
+    *pressure = computePressure(dev, UT, UP);
+    return true;
+}
+
+
 bool BMP180_read(uint8_t i2c_address, float *temperature, float *pressure)
 {
     bmp180_dev_t *dev = BMP180_init(i2c_address, BMP180_HIGHRES);
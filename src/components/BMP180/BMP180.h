@@ -1,3 +1,5 @@
+#include "Wire.h"
+
 #define BMP180_I2C_ADDR 0x77
 
 #define BMP180_CAL_AC1           0xAA  // 16 bits
@@ -33,6 +35,7 @@ typedef struct {
     uint8_t who;
     int16_t ac1, ac2, ac3, b1, b2, mb, mc, md;
     uint16_t ac4, ac5, ac6;
+    WireJob jobs[2];    // Temperature and pressure conversions for the asynchronous read
 } bmp180_dev_t;
 
 
@@ -42,3 +45,8 @@ bool BMP180_read(uint8_t i2c_address, float *temperature, float *pressure);
 bmp180_dev_t* BMP180_init(uint8_t i2c_address, uint8_t oversampling);
 float BMP180_readPressure(bmp180_dev_t *dev);
 float BMP180_readTemperature(bmp180_dev_t *dev);
+
+// Asynchronous read: queue both conversions, poll, then fetch the results.
+bool BMP180_startRead(bmp180_dev_t *dev);
+bool BMP180_readReady(bmp180_dev_t *dev);
+bool BMP180_finishRead(bmp180_dev_t *dev, float *temperature, float *pressure);
@@ -1,17 +1,46 @@
 #include "nvs_flash.h"
+#include "esp_attr.h"
 #include "esp_log.h"
 #include "stdlib.h"
 #include "string.h"
 #include "stdio.h"
+#include "sys/stat.h"
 #include "cJSON.h"
 #include "ConfigProvider.h"
 
 static const char *MODULE = "Config";
 #define _debug ESP_ERROR_CHECK_WITHOUT_ABORT
 
+#define RTC_CACHE_MAGIC 0x43464731 // CFG1
+
+// RTC memory survives deep sleep but is reinitialized on any other reset (power on, OTA reboot, panic)
+typedef struct {
+    uint32_t magic;
+    uint32_t generation;
+    uint32_t length;
+    uint32_t crc;
+    char data[CONFIG_RTC_CACHE_SIZE];
+} rtc_cache_t;
+
+RTC_DATA_ATTR static rtc_cache_t rtc_cache;
+
+static uint32_t crc32(uint32_t crc, const void *data, size_t length)
+{
+    const uint8_t *ptr = (const uint8_t *)data;
+    crc = ~crc;
+    while (length--) {
+        crc ^= *ptr++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
 ConfigProvider::ConfigProvider()
 {
     root = cJSON_CreateObject();
+    generation = 0;
 }
 
 bool ConfigProvider::loadJSON(const char *buffer)
@@ -24,7 +53,7 @@ bool ConfigProvider::loadJSON(const char *buffer)
         return false;
     }
 
-    cJSON_free(root);
+    cJSON_Delete(root);
     root = new_root;
 
     ESP_LOGI(MODULE, "Configuration loaded from string, %d entries found", cJSON_GetArraySize(root));
@@ -36,6 +65,63 @@ char *ConfigProvider::saveJSON()
     return cJSON_Print(root);
 }
 
+/**
+ * Applies a JSON merge patch (RFC 7386). Nested objects are flattened into our dotted
+ * keys (`{"wifi":{"ssid":"x"}}` is `wifi.ssid`) and null removes a key.
+ * Returns the number of keys that actually changed, or -1 if the patch is invalid.
+ */
+int ConfigProvider::mergeJSON(const char *patch, ConfigChangeCallback callback)
+{
+    cJSON *patch_root = cJSON_Parse(patch);
+
+    if (patch_root == NULL || !cJSON_IsObject(patch_root)) {
+        ESP_LOGW(MODULE, "Invalid merge patch");
+        cJSON_Delete(patch_root);
+        return -1;
+    }
+
+    int changes = mergeObject("", patch_root, callback);
+    cJSON_Delete(patch_root);
+
+    ESP_LOGI(MODULE, "Merge patch applied, %d entries changed", changes);
+    return changes;
+}
+
+int ConfigProvider::mergeObject(const char *prefix, cJSON *patch, ConfigChangeCallback callback)
+{
+    int changes = 0;
+    cJSON *item;
+
+    cJSON_ArrayForEach(item, patch) {
+        char key[128];
+        snprintf(key, sizeof(key), "%s%s", prefix, item->string);
+
+        if (cJSON_IsObject(item)) {
+            strncat(key, ".", sizeof(key) - strlen(key) - 1);
+            changes += mergeObject(key, item, callback);
+            continue;
+        }
+
+        cJSON *current = cJSON_GetObjectItem(root, key);
+
+        if (cJSON_IsNull(item)) {
+            if (current == NULL) continue;
+            cJSON_DeleteItemFromObject(root, key);
+        } else if (current == NULL) {
+            cJSON_AddItemToObject(root, key, cJSON_Duplicate(item, true));
+        } else if (!cJSON_Compare(current, item, true)) {
+            cJSON_ReplaceItemInObject(root, key, cJSON_Duplicate(item, true));
+        } else {
+            continue;
+        }
+
+        if (callback) callback(key);
+        changes++;
+    }
+
+    return changes;
+}
+
 bool ConfigProvider::loadFile(const char *file)
 {
     FILE *fp = fopen(file, "rb");
@@ -45,13 +131,28 @@ bool ConfigProvider::loadFile(const char *file)
         return false;
     }
 
-    char *buffer = (char*)malloc(8 * 1024);
-    fread(buffer, 1, 8 * 1024, fp);
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0 || st.st_size <= 0) {
+        ESP_LOGW(MODULE, "Unable to stat file or file empty: %s", file);
+        fclose(fp);
+        return false;
+    }
+
+    char *buffer = (char*)malloc(st.st_size + 1);
+
+    if (buffer == NULL) {
+        ESP_LOGE(MODULE, "Not enough memory to load %s (%ld bytes)", file, (long)st.st_size);
+        fclose(fp);
+        return false;
+    }
+
+    size_t length = fread(buffer, 1, st.st_size, fp);
+    buffer[length] = 0;
+    fclose(fp);
 
     cJSON *new_root = cJSON_Parse(buffer);
 
     free(buffer);
-    fclose(fp);
 
     if (new_root == NULL) {
         ESP_LOGW(MODULE, "Configuration failed to load from %s", file);
@@ -59,7 +160,7 @@ bool ConfigProvider::loadFile(const char *file)
         return false;
     }
 
-    cJSON_free(root);
+    cJSON_Delete(root);
     root = new_root;
 
     ESP_LOGI(MODULE, "Configuration loaded from %s, %d entries found", file, cJSON_GetArraySize(root));
@@ -74,19 +175,28 @@ bool ConfigProvider::saveFile(const char *file, bool update_only)
         return false;
     }
 
+    size_t length = strlen(data);
+
     if (update_only) {
         FILE *fp = fopen(file, "rb");
-        if (fp != NULL) {
-            char *buffer = (char*)malloc(8 * 1024);
-            fread(buffer, 1, 8 * 1024, fp);
-            fclose(fp);
-
-            if (strncmp(buffer, data, strlen(data)) == 0) {
+        struct stat st;
+        // Compare sizes first then a running CRC of the file, so we never hold both documents in memory
+        if (fp != NULL && fstat(fileno(fp), &st) == 0 && st.st_size == (off_t)length) {
+            uint32_t file_crc = 0;
+            char chunk[256];
+            size_t n;
+            while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+                file_crc = crc32(file_crc, chunk, n);
+            }
+            if (file_crc == crc32(0, data, length)) {
                 ESP_LOGI(MODULE, "File content identical, no need to update");
-                free(buffer);
+                fclose(fp);
+                free(data);
                 return false;
             }
-            free(buffer);
+        }
+        if (fp != NULL) {
+            fclose(fp);
         }
     }
 
@@ -98,7 +208,7 @@ bool ConfigProvider::saveFile(const char *file, bool update_only)
         return false;
     }
 
-    bool ret = (fwrite(data, strlen(data), 1, fp) == 1);
+    bool ret = (fwrite(data, length, 1, fp) == 1);
 
     fclose(fp);
     free(data);
@@ -118,6 +228,7 @@ bool ConfigProvider::loadNVS(const char *ns)
     if (nvs_get_str(nvs_h, "json", buffer, &length) == ESP_OK) {
         new_root = cJSON_Parse(buffer);
     }
+    nvs_get_u32(nvs_h, "generation", &generation);
     closeNVS(nvs_h);
     free(buffer);
 
@@ -127,7 +238,7 @@ bool ConfigProvider::loadNVS(const char *ns)
         return false;
     }
 
-    cJSON_free(root);
+    cJSON_Delete(root);
     root = new_root;
 
     ESP_LOGI(MODULE, "Configuration loaded from NVS, %d entries found", cJSON_GetArraySize(root));
@@ -160,6 +271,10 @@ bool ConfigProvider::saveNVS(const char *ns, bool update_only)
 
         if (update) {
             ret = nvs_set_str(nvs_h, "json", data);
+            if (ret == ESP_OK) {
+                nvs_set_u32(nvs_h, "generation", ++generation);
+                clearRTC();
+            }
             ESP_LOGI(MODULE, "NVS content written, result: %s", esp_err_to_name(ret));
         } else {
             ESP_LOGI(MODULE, "NVS content identical, no need to update");
@@ -172,6 +287,64 @@ bool ConfigProvider::saveNVS(const char *ns, bool update_only)
     return (ret == ESP_OK);
 }
 
+bool ConfigProvider::loadRTC()
+{
+    if (rtc_cache.magic != RTC_CACHE_MAGIC || rtc_cache.length >= CONFIG_RTC_CACHE_SIZE) {
+        ESP_LOGI(MODULE, "RTC cache is empty");
+        return false;
+    }
+
+    if (crc32(0, rtc_cache.data, rtc_cache.length) != rtc_cache.crc) {
+        ESP_LOGW(MODULE, "RTC cache CRC mismatch, discarding it");
+        clearRTC();
+        return false;
+    }
+
+    cJSON *new_root = cJSON_Parse(rtc_cache.data);
+
+    if (new_root == NULL) {
+        ESP_LOGW(MODULE, "Configuration failed to load from RTC");
+        clearRTC();
+        return false;
+    }
+
+    cJSON_Delete(root);
+    root = new_root;
+    generation = rtc_cache.generation;
+
+    ESP_LOGI(MODULE, "Configuration loaded from RTC (generation %u), %d entries found", generation, cJSON_GetArraySize(root));
+    return true;
+}
+
+bool ConfigProvider::saveRTC()
+{
+    char *data = cJSON_PrintUnformatted(root);
+    size_t length = data ? strlen(data) : 0;
+
+    clearRTC();
+
+    if (data == NULL || length >= CONFIG_RTC_CACHE_SIZE) {
+        ESP_LOGW(MODULE, "Configuration too large for the RTC cache (%d bytes)", length);
+        free(data);
+        return false;
+    }
+
+    memcpy(rtc_cache.data, data, length + 1);
+    rtc_cache.length = length;
+    rtc_cache.crc = crc32(0, rtc_cache.data, length);
+    rtc_cache.generation = generation;
+    rtc_cache.magic = RTC_CACHE_MAGIC;
+    free(data);
+
+    ESP_LOGI(MODULE, "Configuration saved to RTC (generation %u, %d bytes)", generation, length);
+    return true;
+}
+
+void ConfigProvider::clearRTC()
+{
+    rtc_cache.magic = 0;
+}
+
 nvs_handle ConfigProvider::openNVS(const char *ns)
 {
     esp_err_t err = nvs_flash_init();
@@ -193,6 +366,11 @@ void ConfigProvider::closeNVS(nvs_handle nvs_h)
 }
 
 
+cJSON *ConfigProvider::getItem(const char *key)
+{
+    return cJSON_GetObjectItem(root, key);
+}
+
 char* ConfigProvider::getString(const char *key, char *default_value)
 {
     cJSON *obj = cJSON_GetObjectItem(root, key);
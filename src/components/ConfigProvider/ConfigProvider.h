@@ -2,22 +2,40 @@
 #include "cJSON.h"
 #include "nvs_flash.h"
 
+// Called by mergeJSON() for every key whose value changed
+typedef void (*ConfigChangeCallback)(const char *key);
+
+// Size of the RTC copy of the configuration (RTC slow memory is only 8KB)
+#define CONFIG_RTC_CACHE_SIZE 1536
+
 class ConfigProvider
 {
 private:
     cJSON *root;
+    uint32_t generation;
     nvs_handle openNVS(const char *ns);
     void closeNVS(nvs_handle handle);
+    int  mergeObject(const char *prefix, cJSON *patch, ConfigChangeCallback callback);
 
 public:
     ConfigProvider();
 
     bool  loadJSON(const char *buffer);
     char *saveJSON();
+    int   mergeJSON(const char *patch, ConfigChangeCallback callback = nullptr);
     bool  loadFile(const char *file);
     bool  saveFile(const char *file, bool update_only=false);
     bool  loadNVS(const char *ns);
     bool  saveNVS(const char *ns, bool update_only=false);
+    bool  loadRTC();
+    bool  saveRTC();
+    void  clearRTC();
+
+    // Incremented every time the configuration is written to NVS
+    uint32_t getGeneration() { return generation; }
+
+    cJSON *getItem(const char *key);
+    const cJSON *getRoot() { return root; }
 
     char* getString(const char *key, char *default_value);
     bool  getString(const char *key, char *default_value, char *out);
@@ -127,6 +127,11 @@ void SSD1306Ascii::invertDisplay(bool invert) {
 void SSD1306Ascii::setCol(uint8_t col) {
   if (col < m_displayWidth) {
     m_col = col;
+#if INCLUDE_FRAMEBUFFER
+    if (m_frameBuffered) {
+      return;
+    }
+#endif  // INCLUDE_FRAMEBUFFER
     col += m_colOffset;
     ssd1306WriteCmd(SSD1306_SETLOWCOLUMN | (col & 0XF));
     ssd1306WriteCmd(SSD1306_SETHIGHCOLUMN | (col >> 4));
@@ -155,6 +160,11 @@ void SSD1306Ascii::setFont(const uint8_t* font) {
 void SSD1306Ascii::setRow(uint8_t row) {
   if (row < displayRows()) {
     m_row = row;
+#if INCLUDE_FRAMEBUFFER
+    if (m_frameBuffered) {
+      return;
+    }
+#endif  // INCLUDE_FRAMEBUFFER
 #if INCLUDE_SCROLLING
     ssd1306WriteCmd(SSD1306_SETSTARTPAGE | ((m_row + m_pageOffset) & 7));
 #else  // INCLUDE_SCROLLING
@@ -51,6 +51,10 @@
 /** Use larger faster I2C code. */
 #define OPTIMIZE_I2C 1
 
+/** If INCLUDE_FRAMEBUFFER is nonzero, SSD1306AsciiWire can render into
+    a RAM copy of the display and send only the dirty pages on flush(). */
+#define INCLUDE_FRAMEBUFFER 1
+
 /** If MULTIPLE_I2C_PORTS is nonzero,
     define a constructor with port selection. */
 #ifdef __AVR__
@@ -473,5 +477,8 @@ class SSD1306Ascii : public Print {
   const uint8_t* m_font = nullptr;  // Current font.
   uint8_t m_invertMask = 0;  // font invert mask
   uint8_t m_magFactor = 1;   // Magnification factor.
+#if INCLUDE_FRAMEBUFFER
+  bool m_frameBuffered = false;  // Cursor commands are deferred to flush().
+#endif  // INCLUDE_FRAMEBUFFER
 };
 #endif  // SSD1306Ascii_h
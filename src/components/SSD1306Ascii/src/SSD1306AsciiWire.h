@@ -72,9 +72,83 @@ class SSD1306AsciiWire : public SSD1306Ascii {
   void set400kHz() __attribute__((deprecated("use Wire.setClock(400000L)"))) {
     m_oledWire.setClock(400000L);
   }
+#if INCLUDE_FRAMEBUFFER
+  /**
+   * @brief Render into a RAM copy of the display controller memory.
+   *
+   * Text is drawn into the buffer and nothing is sent until flush(),
+   * which writes each dirty page with a single I2C transfer.
+   * Call it after begin(), the display is assumed to be clear.
+   *
+   * @param[in] enable Allocate the buffer if true else flush and free it.
+   * @return true if the framebuffer is in use.
+   */
+  bool setFrameBuffer(bool enable) {
+    if (enable && !m_frameBuffer) {
+      m_frameWidth = m_displayWidth;
+      m_frameBuffer = (uint8_t*)calloc(8, m_frameWidth);
+      for (uint8_t page = 0; page < 8; page++) {
+        m_dirtyMin[page] = 0XFF;
+        m_dirtyMax[page] = 0;
+      }
+    } else if (!enable && m_frameBuffer) {
+      flush();
+      free(m_frameBuffer);
+      m_frameBuffer = nullptr;
+    }
+    m_frameBuffered = m_frameBuffer != nullptr;
+    if (!m_frameBuffered) {
+      setCursor(m_col, m_row);
+    }
+    return m_frameBuffered;
+  }
+  /**
+   * @brief Send the dirty parts of the framebuffer to the display.
+   */
+  void flush() {
+    if (!m_frameBuffer) {
+      return;
+    }
+    for (uint8_t page = 0; page < 8; page++) {
+      if (m_dirtyMin[page] > m_dirtyMax[page]) {
+        continue;
+      }
+      uint8_t col = m_dirtyMin[page] + m_colOffset;
+      m_oledWire.beginTransmission(m_i2cAddr);
+      m_oledWire.write(0X00);
+      m_oledWire.write(SSD1306_SETLOWCOLUMN | (col & 0XF));
+      m_oledWire.write(SSD1306_SETHIGHCOLUMN | (col >> 4));
+      m_oledWire.write(SSD1306_SETSTARTPAGE | page);
+      m_oledWire.endTransmission();
+      m_oledWire.beginTransmission(m_i2cAddr);
+      m_oledWire.write(0X40);
+      m_oledWire.write(m_frameBuffer + page*m_frameWidth + m_dirtyMin[page],
+                       m_dirtyMax[page] - m_dirtyMin[page] + 1);
+      m_oledWire.endTransmission();
+      m_dirtyMin[page] = 0XFF;
+      m_dirtyMax[page] = 0;
+    }
+  }
+#endif  // INCLUDE_FRAMEBUFFER
 
  protected:
   void writeDisplay(uint8_t b, uint8_t mode) {
+#if INCLUDE_FRAMEBUFFER
+    if (m_frameBuffer && mode != SSD1306_MODE_CMD) {
+#if INCLUDE_SCROLLING
+      uint8_t page = (m_row + m_pageOffset) & 7;
+#else  // INCLUDE_SCROLLING
+      uint8_t page = m_row & 7;
+#endif  // INCLUDE_SCROLLING
+      uint8_t* p = m_frameBuffer + page*m_frameWidth + m_col;
+      if (m_col < m_frameWidth && *p != b) {
+        *p = b;
+        if (m_col < m_dirtyMin[page]) m_dirtyMin[page] = m_col;
+        if (m_col > m_dirtyMax[page]) m_dirtyMax[page] = m_col;
+      }
+      return;
+    }
+#endif  // INCLUDE_FRAMEBUFFER
 #if OPTIMIZE_I2C
     if (m_nData > 16 || (m_nData && mode == SSD1306_MODE_CMD)) {
       m_oledWire.endTransmission();
@@ -107,5 +181,11 @@ class SSD1306AsciiWire : public SSD1306Ascii {
 #if OPTIMIZE_I2C
   uint8_t m_nData;
 #endif  // OPTIMIZE_I2C
+#if INCLUDE_FRAMEBUFFER
+  uint8_t* m_frameBuffer = nullptr;  // 8 pages of m_frameWidth columns.
+  uint8_t m_frameWidth;
+  uint8_t m_dirtyMin[8];  // Dirty column range of each page.
+  uint8_t m_dirtyMax[8];
+#endif  // INCLUDE_FRAMEBUFFER
 };
 #endif  // SSD1306AsciiWire_h
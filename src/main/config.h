@@ -12,11 +12,20 @@
 #define I2C_SDA_PIN 21
 #define I2C_SCL_PIN 22
 #define OLED_I2C_ADDRESS 0x3C
+#define OLED_I2C_CLOCK 400000 // The SSD1306 is rated for fast mode, the sensors stay at the bus default
+#define OLED_FRAMEBUFFER 1 // Render into RAM and only send the changed pages (uses 1KB)
+#define OLED_HEADLESS_LOG 512 // RTC bytes keeping what timer wakes would have displayed
 
 // DHT
 #define DHT_PIN 32
 #define DHT_TYPE DHT22   // or DHT11
 
+// On-chip ADC fallback for the battery and solar inputs when the ADS1115 doesn't answer (-1: disabled)
+// Wire them through the same dividers as the ADS inputs, only ADC1 pins (32-39) work while WiFi is on
+#define ADC_FALLBACK_BAT_PIN -1
+#define ADC_FALLBACK_SOL_PIN -1
+#define ADC_FALLBACK_SAMPLES 16
+
 // ANEMOMETER
 #define ANEMOMETER_PIN 33
 
@@ -24,34 +33,106 @@
 #define NTP_SERVER_1 "pool.ntp.org"
 #define NTP_SERVER_2 "time.nist.gov"
 
+// CONFIGURATION SERVER
+#define HTTP_CHUNK_SIZE 512 // Bytes buffered per response before a chunk is sent
+#define HTTP_SERVER_STACK 8192 // Handlers hold a chunk, printf()'s buffer and newlib's vfprintf frames (the default is 4KB)
+
 // If you rely on those settings don't forget to make erase_flash
 // Otherwise the NVS will have priority
-#define DEFAULT_STATION_NAME                   "SolarStationR3"  // Used as device ID by InfluxDB and SQL, and as group by Adafruit.io
-#define DEFAULT_STATION_GROUP                  "weather"         // Used as measurement prefix in InfluxDB and table prefix in SQL
-#define DEFAULT_STATION_POLL_INTERVAL          60                // Seconds
-#define DEFAULT_STATION_SLEEP_DELAY            10                // Seconds
-#define DEFAULT_STATION_DISPLAY_CONTENT        "Volt: $bat.2 $sol.2\n"   \
-                                               "Light: $l1.0 $l2.0\n"    \
-                                               "Temp: $t1.2 $t2.2\n"     \
-                                               "Humidity: $h1.0 $h2.0\n" \
-                                               "Pres.: $p1.2 $p2.2\n"    \
-                                               "Wind: $ws.2 $wd.0"
-#define DEFAULT_WIFI_SSID                      ""      // 32 per esp-idf
-#define DEFAULT_WIFI_PASSWORD                  ""      // 64 per esp-idf
-#define DEFAULT_WIFI_TIMEOUT                   30      // Seconds
-#define DEFAULT_HTTP_UPDATE_URL                ""      // 128
-#define DEFAULT_HTTP_UPDATE_TYPE               "JSON"  // JSON or InfluxDB
-#define DEFAULT_HTTP_UPDATE_USERNAME           ""      // 64
-#define DEFAULT_HTTP_UPDATE_PASSWORD           ""      // 64
-#define DEFAULT_HTTP_UPDATE_DATABASE           ""      // Only InfluxDB uses this for now
-#define DEFAULT_HTTP_UPDATE_INTERVAL           300     // Seconds
-#define DEFAULT_HTTP_TIMEOUT                   30      // Seconds
-#define DEFAULT_POWER_SAVE_STRATEGY            0       // Not used yet
-#define DEFAULT_POWER_SAVE_TRESHOLD            3.6     // Volts  (Maybe we should use percent so it works on any battery?)
-#define DEFAULT_SENSORS_ADC_MULTIPLIER         2.0     // Factor (If there is a voltage divider)
-#define DEFAULT_SENSORS_ANEMOMETER_RADIUS      15      // centimeters
-#define DEFAULT_SENSORS_ANEMOMETER_CALIBRATION 1       // The calculated value is multiplied by this
+// Columns: Id, Key, Type, Default, Min, Max (for strings min/max is the length)
+#define CONFIG_SCHEMA(X) \
+    X(STATION_NAME,            "station.name",                   STR, "SolarStationR3", 1, 32)    /* Used as device ID by InfluxDB and SQL, and as group by Adafruit.io */ \
+    X(STATION_GROUP,           "station.group",                  STR, "weather",        0, 32)    /* Used as measurement prefix in InfluxDB and table prefix in SQL */ \
+    X(STATION_POLL_INTERVAL,   "station.poll_interval",          INT, 60,               5, 86400) /* Seconds */ \
+    X(STATION_SLEEP_DELAY,     "station.sleep_delay",            INT, 10,               0, 600)   /* Seconds */ \
+    X(STATION_DISPLAY_CONTENT, "station.display_content",        STR, "Volt: $bat.2 $sol.2\n"     \
+                                                                      "Light: $l1.0 $l2.0\n"      \
+                                                                      "Temp: $t1.2 $t2.2\n"       \
+                                                                      "Humidity: $h1.0 $h2.0\n"   \
+                                                                      "Pres.: $p1.2 $p2.2\n"      \
+                                                                      "Wind: $ws.2 $wd.0",   0, 512)   \
+    X(STATION_DISPLAY_REFRESH, "station.display_refresh",        INT, 1000,             0, 60000) /* Milliseconds between live dashboard updates on interactive wakes (0: off) */ \
+    X(WIFI_SSID,               "wifi.ssid",                      STR, "",               0, 32)    \
+    X(WIFI_PASSWORD,           "wifi.password",                  STR, "",               0, 64)    \
+    X(WIFI_TIMEOUT,            "wifi.timeout",                   INT, 30,               1, 300)   /* Seconds */ \
+    X(HTTP_UPDATE_URL,         "http.update.url",                STR, "",               0, 128)   \
+    X(HTTP_UPDATE_TYPE,        "http.update.type",               STR, "JSON",           0, 16)    /* JSON or InfluxDB */ \
+    X(HTTP_UPDATE_USERNAME,    "http.update.username",           STR, "",               0, 64)    \
+    X(HTTP_UPDATE_PASSWORD,    "http.update.password",           STR, "",               0, 64)    \
+    X(HTTP_UPDATE_DATABASE,    "http.update.database",           STR, "",               0, 64)    /* Only InfluxDB uses this for now */ \
+    X(HTTP_UPDATE_INTERVAL,    "http.update.interval",           INT, 300,              0, 86400) /* Seconds */ \
+    X(HTTP_UPDATE_AGGREGATE,   "http.update.aggregate",          INT, 0,                0, 3)     /* 0: raw samples, 1: mean, 2: +min/max, 3: +last/count per interval */ \
+    X(HTTP_UPDATE_HEARTBEAT,   "http.update.heartbeat",          INT, 900,              0, 86400) /* Seconds, unchanged values are resent after that long (0: always send) */ \
+    X(HTTP_TIMEOUT,            "http.timeout",                   INT, 30,               1, 300)   /* Seconds */ \
+    X(HTTP_OTA_ENABLED,        "http.ota.enabled",               INT, 1,                0, 1)     \
+    X(POWERSAVE_STRATEGY,      "powersave.strategy",             INT, 0,                0, 0)     /* Not used yet */ \
+    X(POWERSAVE_THRESHOLD,     "powersave.treshold",             DBL, 3.6,              0, 10)    /* Volts  (Maybe we should use percent so it works on any battery?) */ \
+    X(SENSORS_DEADBAND_SCALE,  "sensors.deadband_scale",         DBL, 1,                0, 100)   /* Multiplies every sensor's deadband (0: only drop exact repeats) */ \
+    X(SENSORS_ADC0_MULTIPLIER, "sensors.adc.adc0_multiplier",    DBL, 2.0,              0, 100)   /* Factor (If there is a voltage divider) */ \
+    X(SENSORS_ADC1_MULTIPLIER, "sensors.adc.adc1_multiplier",    DBL, 2.0,              0, 100)   \
+    X(SENSORS_ADC2_MULTIPLIER, "sensors.adc.adc2_multiplier",    DBL, 2.0,              0, 100)   \
+    X(SENSORS_ADC3_MULTIPLIER, "sensors.adc.adc3_multiplier",    DBL, 2.0,              0, 100)   \
+    X(ANEMOMETER_RADIUS,       "sensors.anemometer.radius",      DBL, 15,               0.1, 100) /* centimeters */ \
+    X(ANEMOMETER_CALIBRATION,  "sensors.anemometer.calibration", DBL, 1,                0.01, 100) /* The calculated value is multiplied by this */
+
+typedef enum {
+    CFG_TYPE_STR,
+    CFG_TYPE_INT,
+    CFG_TYPE_DBL,
+} config_type_t;
+
+typedef struct {
+    const char *key;
+    config_type_t type;
+    const char *str_default;
+    double num_default;
+    double min;
+    double max;
+} config_schema_t;
+
+typedef union {
+    char  *s; // Points to the entry's own copy (config_strings) or to the schema default
+    int    i;
+    double d;
+} config_value_t;
+
+#define CFG_SCHEMA_ID(id, key, type, def, min, max) CFG_##id,
+#define CFG_SCHEMA_ENTRY(id, key, type, def, min, max) {key, CFG_TYPE_##type, CFG_DEFAULT_##type(def), min, max},
+#define CFG_DEFAULT_STR(value) value, 0
+#define CFG_DEFAULT_INT(value) nullptr, value
+#define CFG_DEFAULT_DBL(value) nullptr, value
+#define CFG_SCHEMA_STORAGE(id, key, type, def, min, max) CFG_STORAGE_##type(id, max)
+#define CFG_STORAGE_STR(id, max) char id[(max) + 1];
+#define CFG_STORAGE_INT(id, max)
+#define CFG_STORAGE_DBL(id, max)
+#define CFG_SCHEMA_BUFFER(id, key, type, def, min, max) CFG_BUFFER_##type(id),
+#define CFG_BUFFER_STR(id) config_strings.id
+#define CFG_BUFFER_INT(id) nullptr
+#define CFG_BUFFER_DBL(id) nullptr
+
+typedef enum { CONFIG_SCHEMA(CFG_SCHEMA_ID) CFG_COUNT } config_id_t;
+constexpr config_schema_t CONFIG_SCHEMA_TABLE[] = { CONFIG_SCHEMA(CFG_SCHEMA_ENTRY) };
+
+// Effective values, resolved from the configuration tree by loadConfiguration()
+static config_value_t config_values[CFG_COUNT];
+
+// Strings are copied out of the tree (which is freed whenever the configuration is reloaded), max + 1 bytes each
+static struct { CONFIG_SCHEMA(CFG_SCHEMA_STORAGE) } config_strings;
+static char *const CONFIG_STRING_BUFFERS[CFG_COUNT] = { CONFIG_SCHEMA(CFG_SCHEMA_BUFFER) };
+
+template <config_id_t id, config_type_t type>
+inline config_value_t &config_get()
+{
+    static_assert(CONFIG_SCHEMA_TABLE[id].type == type, "Configuration key used with the wrong type");
+    return config_values[id];
+}
 
 // ConfigProvider settings
 #define CONFIG_USE_FILE "/sd/config.json"
 #define CONFIG_USE_NVS "configuration"
+#define CONFIG_AFFECTS_WIFI    (1 << 0)
+#define CONFIG_AFFECTS_SENSORS (1 << 1)
+#define CONFIG_AFFECTS_DISPLAY (1 << 2)
+#define CONFIG_AFFECTS_VALUES  (1 << 3) // Any change, the effective values must be resolved again
+#define MEMORY_TRACE_LEAKS 0 // Records kept to dump each phase's unfreed allocations, needs CONFIG_HEAP_TRACING_STANDALONE
+#define BENCHMARK_CONFIG_LOAD 0 // Log the time taken by both the RTC and NVS configuration paths
@@ -1,49 +1,151 @@
 #include "SSD1306AsciiWire.h"
 
+// What headless wakes would have displayed, replayed on the next interactive wake
+RTC_DATA_ATTR static char display_log[OLED_HEADLESS_LOG];
+RTC_DATA_ATTR static uint16_t display_log_len = 0;
+
+static void displayLog(const char *text, size_t length)
+{
+    if (length >= OLED_HEADLESS_LOG) {
+        text += length - (OLED_HEADLESS_LOG - 1);
+        length = OLED_HEADLESS_LOG - 1;
+    }
+    if (display_log_len + length >= OLED_HEADLESS_LOG) { // Drop the oldest output
+        size_t drop = display_log_len + length - (OLED_HEADLESS_LOG - 1);
+        memmove(display_log, display_log + drop, display_log_len - drop);
+        display_log_len -= drop;
+    }
+    memcpy(display_log + display_log_len, text, length);
+    display_log_len += length;
+}
+
+// Where the output goes without a display: the console, and the RTC log on headless wakes
+class DisplayConsole : public Print
+{
+  public:
+    bool headless = false;
+
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size)
+    {
+        fwrite(buffer, 1, size, stdout);
+        if (headless) displayLog((const char *)buffer, size);
+        return size;
+    }
+    using Print::write;
+};
+
 static class {
     SSD1306AsciiWire m_display;
+    DisplayConsole m_console;
+    SemaphoreHandle_t m_lock = NULL;
     bool m_useOLED = false;
+
   public:
+    // The server draws from its own task during a firmware upgrade, every entry point holds this lock.
+    // It is recursive so that a caller can hold it for a whole frame.
+    void lock() { if (m_lock) xSemaphoreTakeRecursive(m_lock, portMAX_DELAY); }
+    void unlock() { if (m_lock) xSemaphoreGiveRecursive(m_lock); }
+
     void begin()
     {
-        Wire.beginTransmission(OLED_I2C_ADDRESS);
-        m_useOLED = (Wire.endTransmission() == 0);
+        if (!m_lock) m_lock = xSemaphoreCreateRecursiveMutex();
+        lock();
+        Wire.setDeviceClock(OLED_I2C_ADDRESS, OLED_I2C_CLOCK);
+        m_useOLED = Wire.probe(OLED_I2C_ADDRESS);
+        m_console.headless = false;
 
         if (m_useOLED) {
             m_display.begin(&Adafruit128x64, OLED_I2C_ADDRESS);
             m_display.setFont(System5x7);
             m_display.setScrollMode(SCROLL_MODE_AUTO);
+            m_display.setFrameBuffer(OLED_FRAMEBUFFER);
+            if (display_log_len > 0) {
+                write(display_log, display_log_len);
+                write("\n", 1);
+                flush();
+            }
         }
+        display_log_len = 0;
+        unlock();
+    }
+
+    // Nobody is looking: never touch the display, keep the output in RTC memory instead
+    void beginHeadless()
+    {
+        if (!m_lock) m_lock = xSemaphoreCreateRecursiveMutex();
+        m_useOLED = false;
+        m_console.headless = true;
     }
 
     void end()
     {
+        lock();
         if (m_useOLED) m_display.ssd1306WriteCmd(SSD1306_DISPLAYOFF);
+        unlock();
     }
 
     void clear()
     {
-        if (m_useOLED) m_display.clear();
+        lock();
+        if (m_useOLED) {
+            m_display.clear();
+            m_display.flush();
+        }
+        unlock();
     }
 
     void printf(const char *format, ...)
     {
-        char buffer[512];
-        va_list argptr;
-        va_start(argptr, format);
-        vsprintf(buffer, format, argptr);
-        va_end(argptr);
+        va_list args;
+        va_start(args, format);
+        lock();
+        if (m_useOLED) {
+            m_display.vprintf(format, args);
+            m_display.flush();
+        } else {
+            fputs("[DISPLAY] ", stdout);
+            m_console.vprintf(format, args);
+        }
+        unlock();
+        va_end(args);
+    }
 
+    // Used by the dashboard to redraw a single field, call flush() when done
+    void printAt(uint8_t col, uint8_t row, const char *text, uint8_t clear_chars)
+    {
+        if (!m_useOLED) return;
+        lock();
+        m_display.clearField(col, row, clear_chars);
+        m_display.setCursor(col, row);
+        m_display.write(text);
+        unlock();
+    }
+
+    // Unformatted output of any length, call flush() when done
+    void write(const char *text, size_t length)
+    {
+        lock();
         if (m_useOLED) {
-            char *c = buffer;
-            while (*c != 0) {
-                m_display.write(*c++);
-            }
+            m_display.write(text, length);
         } else {
-            ::printf("[DISPLAY] %s", buffer);
+            fputs("[DISPLAY] ", stdout);
+            m_console.write(text, length);
         }
+        unlock();
     }
 
+    void flush()
+    {
+        lock();
+        if (m_useOLED) m_display.flush();
+        unlock();
+    }
+
+    uint8_t col() { return m_useOLED ? m_display.col() : 0; }
+    uint8_t row() { return m_useOLED ? m_display.row() : 0; }
+    bool scrolled() { return m_useOLED && m_display.pageOffset() != 0; }
+
     bool isPresent()
     {
         return m_useOLED;
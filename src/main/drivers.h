@@ -0,0 +1,215 @@
+#include "Adafruit_ADS1015.h"
+#include "Adafruit_BME280.h"
+#include "BMP180.h"
+#include "DHT.h"
+
+#define SENSOR_DRIVER_MAX_VALUES 4
+#define SENSOR_DRIVER_TIMEOUT 2000 // ms
+
+// A sensor driver feeds up to SENSOR_DRIVER_MAX_VALUES attributes (channels) of one sensor type.
+// Only begin() and read() are mandatory. pollSensors() starts all drivers then reads them as they become ready.
+// I2C drivers queue their conversions on Wire's job task in start() so that they overlap, ready() polls the jobs.
+typedef struct {
+    uint8_t type;                // SENSOR_TYPE_t
+    const char *name;
+    bool (*begin)();             // Detect and configure the sensor
+    uint32_t (*start)();         // Start a conversion, returns how long it should take (ms)
+    bool (*ready)();             // Conversion done? If NULL we rely on start()'s return value
+    int  (*read)(float *values); // Fetch the results, returns the number of values or -1 on error
+    void (*sleep)();             // Put the sensor back to sleep and release resources
+    int  (*peek)(float *values); // Non-blocking read for the live dashboard after pollSensors(), 0 if nothing new, NULL if impossible
+} SENSOR_DRIVER_t;
+
+
+static Adafruit_ADS1115 ads;
+
+static WireJob ads_jobs[4];
+static bool ads_fallback = false; // Using the on-chip ADC for the battery and solar channels
+
+static bool ads_begin()
+{
+    ads_fallback = false;
+    if (ads.begin()) {
+        ads.setGain(GAIN_ONE); // real range is vdd + 0.3
+        return true;
+    }
+    if (ADC_FALLBACK_BAT_PIN >= 0 || ADC_FALLBACK_SOL_PIN >= 0) {
+        ESP_LOGW(__func__, "ADS1115 not responding, using the on-chip ADC");
+        return ads_fallback = true;
+    }
+    return false;
+}
+
+static int ads_fallback_read(float *values)
+{
+    int bat = (ADC_FALLBACK_BAT_PIN >= 0) ? analogReadMilliVolts(ADC_FALLBACK_BAT_PIN, ADC_FALLBACK_SAMPLES, true) : -1;
+    int sol = (ADC_FALLBACK_SOL_PIN >= 0) ? analogReadMilliVolts(ADC_FALLBACK_SOL_PIN, ADC_FALLBACK_SAMPLES, true) : -1;
+    if (bat < 0) {
+        return -1; // Values are positional, without the battery the solar one has nowhere to go
+    }
+    values[0] = bat / 1000.0f * CFG_DBL(SENSORS_ADC0_MULTIPLIER);
+    values[1] = sol / 1000.0f * CFG_DBL(SENSORS_ADC1_MULTIPLIER);
+    return (sol < 0) ? 1 : 2;
+}
+
+static uint32_t ads_start()
+{
+    if (ads_fallback) {
+        return 0;
+    }
+    if (ads_jobs[3].address && !Wire.done(&ads_jobs[3])) {
+        return 0; // Still running from a poll that timed out, it can't be queued twice
+    }
+    for (int i = 0; i < 4; i++) {
+        ads.queueADC_SingleEnded(i, &ads_jobs[i]);
+    }
+    return 0;
+}
+
+static bool ads_ready()
+{
+    if (ads_fallback) return true;
+    return Wire.done(&ads_jobs[3]); // Conversions on the same device complete in order
+}
+
+static int ads_collect(float *values)
+{
+    const float vbit = 0.000125;
+    if (ads_fallback) {
+        return ads_fallback_read(values);
+    }
+    for (int i = 0; i < 4; i++) {
+        if (ads_jobs[i].status != ESP_OK) return -1;
+    }
+    values[0] = (short)ads.getJobResult(&ads_jobs[0]) * vbit * CFG_DBL(SENSORS_ADC0_MULTIPLIER);
+    values[1] = (short)ads.getJobResult(&ads_jobs[1]) * vbit * CFG_DBL(SENSORS_ADC1_MULTIPLIER);
+    values[2] = (short)ads.getJobResult(&ads_jobs[2]) * vbit * CFG_DBL(SENSORS_ADC2_MULTIPLIER);
+    values[3] = (short)ads.getJobResult(&ads_jobs[3]) * vbit * CFG_DBL(SENSORS_ADC3_MULTIPLIER);
+    return 4;
+}
+
+// Returns the conversions queued by the previous call (or by the last poll) and queues the next ones
+static int ads_peek(float *values)
+{
+    if (ads_fallback) {
+        return ads_fallback_read(values);
+    }
+    int count = 0;
+    if (ads_jobs[3].address) {
+        if (!Wire.done(&ads_jobs[3])) {
+            return 0; // Still converting, the dashboard will get them next time
+        }
+        count = ads_collect(values);
+    }
+    ads_start();
+    return count;
+}
+
+
+static bmp180_dev_t *bmp180 = NULL;
+
+static bool bmp_begin()
+{
+    return (bmp180 = BMP180_init(BMP180_I2C_ADDR, BMP180_HIGHRES)) != NULL;
+}
+
+static uint32_t bmp_start()
+{
+    BMP180_startRead(bmp180);
+    return 0;
+}
+
+static bool bmp_ready()
+{
+    return BMP180_readReady(bmp180);
+}
+
+static int bmp_read(float *values)
+{
+    return BMP180_finishRead(bmp180, &values[0], &values[1]) ? 2 : -1;
+}
+
+static void bmp_sleep()
+{
+    // If we timed out the I2C task might still be using the jobs, better leak than corrupt
+    if (Wire.wait(&bmp180->jobs[1]) == ESP_ERR_TIMEOUT) {
+        ESP_LOGE(__func__, "BMP180 conversion stuck");
+        bmp180 = NULL;
+        return;
+    }
+    free(bmp180);
+    bmp180 = NULL;
+}
+
+
+static Adafruit_BME280 bme280;
+
+static bool bme_begin()
+{
+    return bme280.begin();
+}
+
+static int bme_read(float *values)
+{
+    values[0] = bme280.readTemperature();
+    values[1] = bme280.readHumidity();
+    values[2] = bme280.readPressure() / 1000;
+    return 3;
+}
+
+
+static bool dht_begin()
+{
+    return true; // We can't probe it without doing a full read
+}
+
+static int dht_driver_read(float *values)
+{
+    return dht_read(DHT_TYPE, DHT_PIN, &values[0], &values[1]) ? 2 : -1;
+}
+
+
+static bool wind_begin()
+{
+    return true;
+}
+
+static int wind_read(float *values)
+{
+    values[0] = ulp_wind_read_kph(true);
+    values[1] = 0;
+    return 2;
+}
+
+static int wind_peek(float *values)
+{
+    values[0] = ulp_wind_live_kph();
+    values[1] = 0;
+    return 2;
+}
+
+
+static bool null_begin()
+{
+    return true;
+}
+
+static int null_read(float *values)
+{
+    for (int i = 0; i < SENSOR_DRIVER_MAX_VALUES; i++) {
+        values[i] = 0;
+    }
+    return SENSOR_DRIVER_MAX_VALUES;
+}
+
+
+static const SENSOR_DRIVER_t SENSOR_DRIVERS[] = {
+    // Type,       Name,      begin,      start,     ready,     read,            sleep,     peek
+    {SENSOR_ADS,  "ADS1115", ads_begin,  ads_start, ads_ready, ads_collect,     NULL,      ads_peek},
+    {SENSOR_BMP,  "BMP180",  bmp_begin,  bmp_start, bmp_ready, bmp_read,        bmp_sleep, NULL},
+    {SENSOR_BME,  "BME280",  bme_begin,  NULL,      NULL,      bme_read,        NULL,      NULL},
+    {SENSOR_DHT,  "DHT",     dht_begin,  NULL,      NULL,      dht_driver_read, NULL,      NULL},
+    {SENSOR_WIND, "WIND",    wind_begin, NULL,      NULL,      wind_read,       NULL,      wind_peek},
+    {SENSOR_NULL, "NULL",    null_begin, NULL,      NULL,      null_read,       NULL,      NULL},
+};
+const int SENSOR_DRIVERS_COUNT = (sizeof(SENSOR_DRIVERS) / sizeof(SENSOR_DRIVER_t));
@@ -9,20 +9,39 @@
 #include <esp_system.h>
 #include <esp_sleep.h>
 #include <esp_log.h>
+#include <freertos/semphr.h>
 
 #include "config.h"
 #include "macros.h"
+#include "memory.h"
 #include "display.h"
+#include "stats.h"
 #include "sensors.h"
 #include "ulp.h"
 #include "ntp.h"
 
+// Raw samples are packed: this header is followed by one float per bit set in sensors_present
 typedef struct {
     int64_t  uptime; // Uptime can work before NTP lock, timestamp cannot
-    float    sensors_data[SENSORS_COUNT];
-    uint32_t sensors_status;
+    uint32_t sensors_status;  // Sensors in error
+    uint32_t sensors_present; // Sensors that changed enough since they were last queued (or are due a heartbeat)
 } message_t;
-const int MESSAGE_QUEUE_SIZE = 2048 / sizeof(message_t);
+
+// Summary of the samples taken during one upload interval, used when http.update.aggregate > 0
+typedef struct {
+    int64_t  start;  // Uptime of the first sample
+    int64_t  uptime; // Uptime of the last sample
+    uint32_t sensors_status; // Sensors without a single valid sample
+    uint16_t samples;
+    uint16_t count[SENSORS_COUNT];
+    float    mean[SENSORS_COUNT];
+    float    min[SENSORS_COUNT];
+    float    max[SENSORS_COUNT];
+    float    last[SENSORS_COUNT];
+} aggregate_t;
+
+#define MESSAGE_QUEUE_BYTES 2048
+static_assert(sizeof(aggregate_t) % 8 == 0, "Queue records must stay 8 bytes aligned");
 
 RTC_DATA_ATTR static int32_t wake_count = 0;
 RTC_DATA_ATTR static int64_t first_boot_time = 0;
@@ -30,9 +49,16 @@ RTC_DATA_ATTR static int64_t next_http_update = 0;
 RTC_DATA_ATTR static int64_t ntp_time_delta = 0;
 RTC_DATA_ATTR static int64_t ntp_last_adjustment = 0;
 RTC_DATA_ATTR static double  time_correction = 0;
-RTC_DATA_ATTR static message_t message_queue[MESSAGE_QUEUE_SIZE];
-RTC_DATA_ATTR static int16_t message_queue_pos = 0;
+RTC_DATA_ATTR static uint8_t message_queue[MESSAGE_QUEUE_BYTES] __attribute__((aligned(8))); // FIFO of records
+RTC_DATA_ATTR static int16_t message_queue_len = 0;  // Bytes used
+RTC_DATA_ATTR static int8_t  message_queue_mode = 0; // 0: message_t records, 1: aggregate_t records
+RTC_DATA_ATTR static float   sensors_reported[SENSORS_COUNT];      // Last value queued
+RTC_DATA_ATTR static int64_t sensors_reported_time[SENSORS_COUNT]; // When it was queued, 0 if never
+static uint32_t config_changes = 0; // CONFIG_AFFECTS_*, set by the server and applied by the main task
+static SemaphoreHandle_t config_lock = NULL; // Held while the server modifies the tree and while the main task reads it
 static bool is_interactive_wakeup = true;
+static bool dashboard_active = false;
+static bool firmware_upgrading = false; // The server owns the display until the next wake
 static long sleep_timeout = 0;
 static httpd_handle_t httpd = NULL;
 ConfigProvider config;
@@ -74,36 +100,312 @@ static bool debounceButton(int gpio, int level, int threshold = 50)
 }
 
 
-static void loadConfiguration()
+static SemaphoreHandle_t button_event = NULL; // Also given by the server to wake waitButton() early
+
+static void IRAM_ATTR buttonISR()
+{
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(button_event, &woken);
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+// Blocks until the button goes down (true) or millis() reaches the deadline (false)
+static bool waitButton(unsigned long deadline)
+{
+    if (button_event == NULL) {
+        button_event = xSemaphoreCreateBinary();
+        attachInterrupt(ACTION_BUTTON_PIN, buttonISR, FALLING);
+    }
+    unsigned long now = millis();
+    return xSemaphoreTake(button_event, deadline > now ? (deadline - now) / portTICK_PERIOD_MS : 0) == pdTRUE;
+}
+
+
+// Resolve the effective value of every schema entry in a single pass, the tree itself is never modified.
+// config_values, the string buffers and the display template are read by the main task, so only it calls this.
+static void resolveConfiguration()
+{
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+
+    for (int id = 0; id < CFG_COUNT; id++) {
+        const config_schema_t *schema = &CONFIG_SCHEMA_TABLE[id];
+        config_value_t *value = &config_values[id];
+        cJSON *item = config.getItem(schema->key);
+        bool valid = (item == NULL); // A missing key simply means default
+
+        if (schema->type == CFG_TYPE_STR) {
+            char *string = (char*)schema->str_default;
+            if (cJSON_IsString(item)) {
+                size_t length = strlen(item->valuestring);
+                if (length >= schema->min && length <= schema->max) {
+                    string = CONFIG_STRING_BUFFERS[id];
+                    if (strcmp(string, item->valuestring) != 0) { // Unchanged values are left alone for other tasks
+                        memcpy(string, item->valuestring, length + 1);
+                    }
+                    valid = true;
+                }
+            }
+            value->s = string;
+        } else {
+            double number = schema->num_default;
+            if (cJSON_IsNumber(item) && item->valuedouble >= schema->min && item->valuedouble <= schema->max) {
+                number = item->valuedouble;
+                valid = true;
+            }
+            if (schema->type == CFG_TYPE_INT) {
+                value->i = (int)number;
+            } else {
+                value->d = number;
+            }
+        }
+
+        if (!valid) {
+            ESP_LOGW("config", "Rejected invalid value for '%s', using default", schema->key);
+        }
+    }
+
+    xSemaphoreGive(config_lock);
+
+    compileDisplayTemplate(CFG_STR(STATION_DISPLAY_CONTENT));
+}
+
+
+static void printJSONString(Print &out, const char *text)
+{
+    const char *plain = text;
+    out.write('"');
+    for (; *text; text++) {
+        unsigned char c = *text;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.write(plain, text - plain);
+        plain = text + 1;
+        if (c == '"' || c == '\\') {
+            out.write('\\');
+            out.write(c);
+        } else if (c == '\n') {
+            out.write("\\n");
+        } else if (c == '\t') {
+            out.write("\\t");
+        } else {
+            out.printf("\\u%04x", c);
+        }
+    }
+    out.write(plain, text - plain);
+    out.write('"');
+}
+
+
+// The effective values followed by the stored keys we don't know, used to show every setting to the user.
+// It is printed one value at a time so that its size isn't limited by RAM.
+static void configPrintJSON(Print &out)
 {
-    config.loadNVS(CONFIG_USE_NVS);
+    const char *separator = "{\n";
+
+    for (int id = 0; id < CFG_COUNT; id++) {
+        const config_schema_t *schema = &CONFIG_SCHEMA_TABLE[id];
+        out.print(separator);
+        out.write('\t');
+        printJSONString(out, schema->key);
+        out.write(":\t");
+        if (schema->type == CFG_TYPE_STR) {
+            printJSONString(out, config_values[id].s);
+        } else if (schema->type == CFG_TYPE_INT) {
+            out.printf("%d", config_values[id].i);
+        } else {
+            out.printf("%1.15g", config_values[id].d);
+        }
+        separator = ",\n";
+    }
 
-    CFG_LOAD_STR("station.name", DEFAULT_STATION_NAME);
-    CFG_LOAD_STR("station.group", DEFAULT_STATION_GROUP);
-    CFG_LOAD_INT("station.poll_interval", DEFAULT_STATION_POLL_INTERVAL);
-    CFG_LOAD_INT("station.sleep_delay", DEFAULT_STATION_SLEEP_DELAY);
-    CFG_LOAD_STR("station.display_content", DEFAULT_STATION_DISPLAY_CONTENT);
-    CFG_LOAD_STR("wifi.ssid", DEFAULT_WIFI_SSID);
-    CFG_LOAD_STR("wifi.password", DEFAULT_WIFI_PASSWORD);
-    CFG_LOAD_INT("wifi.timeout", DEFAULT_WIFI_TIMEOUT);
-    CFG_LOAD_STR("http.update.url", DEFAULT_HTTP_UPDATE_URL);
-    CFG_LOAD_STR("http.update.type", DEFAULT_HTTP_UPDATE_TYPE);
-    CFG_LOAD_STR("http.update.username", DEFAULT_HTTP_UPDATE_USERNAME);
-    CFG_LOAD_STR("http.update.password", DEFAULT_HTTP_UPDATE_PASSWORD);
-    CFG_LOAD_STR("http.update.database", DEFAULT_HTTP_UPDATE_DATABASE);
-    CFG_LOAD_INT("http.update.interval", DEFAULT_HTTP_UPDATE_INTERVAL);
-    CFG_LOAD_INT("http.timeout", DEFAULT_HTTP_TIMEOUT);
-    CFG_LOAD_INT("http.ota.enabled", 1);
-    CFG_LOAD_DBL("powersave.strategy", DEFAULT_POWER_SAVE_STRATEGY);
-    CFG_LOAD_DBL("powersave.treshold", DEFAULT_POWER_SAVE_TRESHOLD);
-    CFG_LOAD_DBL("sensors.adc.adc0_multiplier", DEFAULT_SENSORS_ADC_MULTIPLIER);
-    CFG_LOAD_DBL("sensors.adc.adc1_multiplier", DEFAULT_SENSORS_ADC_MULTIPLIER);
-    CFG_LOAD_DBL("sensors.adc.adc2_multiplier", DEFAULT_SENSORS_ADC_MULTIPLIER);
-    CFG_LOAD_DBL("sensors.adc.adc3_multiplier", DEFAULT_SENSORS_ADC_MULTIPLIER);
-    CFG_LOAD_DBL("sensors.anemometer.radius", DEFAULT_SENSORS_ANEMOMETER_RADIUS);
-    CFG_LOAD_DBL("sensors.anemometer.calibration", DEFAULT_SENSORS_ANEMOMETER_CALIBRATION);
+    const cJSON *item;
+    cJSON_ArrayForEach(item, config.getRoot()) {
+        int id = 0;
+        while (id < CFG_COUNT && strcmp(CONFIG_SCHEMA_TABLE[id].key, item->string) != 0) {
+            id++;
+        }
+        if (id < CFG_COUNT) {
+            continue; // Already printed with its effective value
+        }
+        char *value = cJSON_PrintUnformatted(item);
+        if (value == NULL) {
+            continue;
+        }
+        out.print(separator);
+        out.write('\t');
+        printJSONString(out, item->string);
+        out.write(":\t");
+        out.print(value);
+        cJSON_free(value);
+        separator = ",\n";
+    }
+
+    out.print(*separator == '{' ? "{}" : "\n}");
+}
 
-    ESP_LOGI("config", "Station name: '%s', group: '%s'", CFG_STR("STATION.NAME"), CFG_STR("STATION.GROUP"));
+
+static void printJSONFloat(Print &out, float value)
+{
+    if (isfinite(value)) {
+        out.printf("%.4f", value);
+    } else {
+        out.print("null"); // JSON has no NaN or Infinity
+    }
+}
+
+
+static size_t messageSize(const uint8_t *record);
+
+// What /sensors serializes, copied under sensors_lock so that the main task can keep polling and queueing
+typedef struct {
+    SENSOR_t sensors[SENSORS_COUNT];
+    uint32_t generation;
+    int64_t next_upload;
+    int16_t queue_len;
+    int8_t queue_mode;
+    int records;
+} sensors_snapshot_t;
+
+static void sensorsSnapshot(sensors_snapshot_t *snapshot)
+{
+    sensorsLock();
+    memcpy(snapshot->sensors, SENSORS, sizeof(SENSORS));
+    snapshot->generation = sensors_generation;
+    snapshot->next_upload = next_http_update;
+    snapshot->queue_len = message_queue_len;
+    snapshot->queue_mode = message_queue_mode;
+    snapshot->records = 0;
+    for (size_t offset = 0; offset < message_queue_len; offset += messageSize(message_queue + offset)) {
+        snapshot->records++;
+    }
+    sensorsUnlock();
+}
+
+
+// Current values, statistics, status and upload backlog for /sensors, printed without building a cJSON tree
+static void sensorsPrintJSON(Print &out, const sensors_snapshot_t *snapshot)
+{
+    int64_t now = uptime();
+
+    out.print("{\"station\":");
+    printJSONString(out, CFG_STR(STATION_NAME));
+    out.print(",\"group\":");
+    printJSONString(out, CFG_STR(STATION_GROUP));
+    out.printf(",\"version\":\"%s\",\"uptime\":%lld,\"cycles\":%d,\"generation\":%u",
+        PROJECT_VERSION, now, wake_count, snapshot->generation);
+    out.printf(",\"queue\":{\"records\":%d,\"bytes\":%d,\"capacity\":%d,\"aggregate\":%d,\"next_upload\":%lld}",
+        snapshot->records, snapshot->queue_len, MESSAGE_QUEUE_BYTES,
+        snapshot->queue_mode ? CFG_INT(HTTP_UPDATE_AGGREGATE) : 0, snapshot->next_upload - rtc_millis());
+    out.print(",\"sensors\":{");
+
+    for (int i = 0; i < SENSORS_COUNT; i++) {
+        const SENSOR_t *sensor = &snapshot->sensors[i];
+        const sensor_stats_t *stats = &sensor->stats;
+        out.printf("%s\"%s\":{\"unit\":\"%s\",\"status\":%d,\"value\":",
+            i ? "," : "", SENSORS_DEF[i].key, SENSORS_DEF[i].unit, sensor->status);
+        if (sensor->status == SENSOR_OK) {
+            printJSONFloat(out, sensor->val);
+        } else {
+            out.print("null");
+        }
+        if (stats->n > 0) {
+            out.print(",\"avg\":");
+            printJSONFloat(out, statsWindowMean(stats));
+            out.print(",\"dev\":");
+            printJSONFloat(out, statsStdDev(stats));
+            out.print(",\"ewma\":");
+            printJSONFloat(out, stats->ewma);
+            out.print(",\"min\":");
+            printJSONFloat(out, statsRolling(stats, now, false));
+            out.print(",\"max\":");
+            printJSONFloat(out, statsRolling(stats, now, true));
+        }
+        out.printf(",\"count\":%u}", stats->n);
+    }
+
+    out.print("}}");
+}
+
+
+static void loadConfiguration(bool use_cache = false)
+{
+    int64_t start = esp_timer_get_time();
+
+#if BENCHMARK_CONFIG_LOAD
+    // Time both paths so we can compare them, the NVS one is used for the actual configuration
+    if (config.loadRTC()) {
+        ESP_LOGI("Benchmark", "Configuration from RTC: %lldus", esp_timer_get_time() - start);
+    }
+    start = esp_timer_get_time();
+    use_cache = false;
+#endif
+
+    // The RTC copy is only trusted on timer wakes
+    bool from_cache = use_cache && config.loadRTC();
+
+    if (!from_cache) {
+        config.loadNVS(CONFIG_USE_NVS);
+        config.saveRTC();
+    }
+
+    resolveConfiguration();
+
+    ESP_LOGI("config", "Configuration (generation %u) loaded from %s in %lldus",
+        config.getGeneration(), from_cache ? "RTC" : "NVS", esp_timer_get_time() - start);
+    ESP_LOGI("config", "Station name: '%s', group: '%s'", CFG_STR(STATION_NAME), CFG_STR(STATION_GROUP));
+}
+
+
+static void onConfigChange(const char *key)
+{
+    if (strncasecmp(key, "wifi.", 5) == 0) {
+        __atomic_fetch_or(&config_changes, CONFIG_AFFECTS_WIFI, __ATOMIC_SEQ_CST);
+    } else if (strncasecmp(key, "sensors.", 8) == 0) {
+        __atomic_fetch_or(&config_changes, CONFIG_AFFECTS_SENSORS, __ATOMIC_SEQ_CST);
+    } else if (strcasecmp(key, "station.display_content") == 0) {
+        __atomic_fetch_or(&config_changes, CONFIG_AFFECTS_DISPLAY, __ATOMIC_SEQ_CST);
+    }
+    ESP_LOGI("config", "Key '%s' changed", key);
+}
+
+
+// Re-initialize only the subsystems affected by a partial configuration update.
+// They belong to the main task, so only its wait loops call this.
+static void applyConfigChanges()
+{
+    uint32_t changes = __atomic_exchange_n(&config_changes, 0, __ATOMIC_SEQ_CST);
+
+    if (changes & CONFIG_AFFECTS_VALUES) {
+        resolveConfiguration();
+    }
+
+    if (changes & CONFIG_AFFECTS_SENSORS) {
+        ESP_LOGI("config", "Sensors settings changed, resetting averages");
+        sensorsLock();
+        for (int i = 0; i < SENSORS_COUNT; i++) {
+            statsReset(&SENSORS[i].stats);
+        }
+        sensorsUnlock();
+    }
+
+    if (changes & CONFIG_AFFECTS_DISPLAY) {
+        if (dashboard_active) {
+            display_fields_valid = false; // The dashboard loop owns the display, it will redraw
+        } else if (!firmware_upgrading) {
+            Display.lock();
+            Display.clear();
+            displaySensors();
+            Display.unlock();
+        }
+    }
+
+    if ((changes & CONFIG_AFFECTS_WIFI) && WiFi.mode() == WL_MODE_STA) {
+        ESP_LOGI("config", "WiFi settings changed, reconnecting to '%s'", CFG_STR(WIFI_SSID));
+        WiFi.begin(CFG_STR(WIFI_SSID), CFG_STR(WIFI_PASSWORD));
+    }
 }
 
 
@@ -117,13 +419,14 @@ static void hibernate()
 
     // Cleanup
     Display.end();
+    ulp_wind_live_stop();
 
     // See how much memory we never freed
-    PRINT_MEMORY_STATS();
+    memoryReport();
 
     // Sleep
     // To do: account for ESP32 boot time before millis timer is started (100+ ms)
-    int sleep_time = (CFG_INT("STATION.POLL_INTERVAL") * 1000) - millis();
+    int sleep_time = (CFG_INT(STATION_POLL_INTERVAL) * 1000) - millis();
 
     if (sleep_time < 0) {
         ESP_LOGW(__func__, "Bogus sleep time, did we spend too much time processing?");
@@ -148,8 +451,13 @@ static void hibernate()
 
 static bool firmware_upgrade_begin()
 {
+    // Waits for the dashboard frame being drawn, the main task won't draw again
+    Display.lock();
+    firmware_upgrading = true;
+    dashboard_active = false;
     Display.clear();
     Display.printf("Upgrading firmware...\n");
+    Display.unlock();
 
     if (!FwUpdater.begin()) {
         if (FwUpdater.getError() == FWU_ERR_OTA_PARTITION_IN_USE) {
@@ -170,6 +478,7 @@ static bool firmware_upgrade_begin()
 static bool firmware_upgrade_end()
 {
     if (FwUpdater.end()) {
+        config.clearRTC(); // The new firmware might not agree with our defaults
         Display.printf("\n\nComplete!");
         return true;
     } else {
@@ -202,22 +511,103 @@ static void urldecode(char *input)
 }
 
 
-static void http_response(httpd_req_t * req, const char *body)
+// Sends what is printed to it as HTTP chunks of at most HTTP_CHUNK_SIZE bytes, call end() to finish the response
+class HttpResponse : public Print
 {
-    const char *format = "<html><head><meta name=viewport content='width=device-width,initial-scale=0'><style>" \
-        "body{font-family:sans-serif}label,input,a{font-size:2em;margin:0 5px}textarea{-moz-tab-size:2;;width:100%%;height:75vh}" \
-        "</style></head><body><h1>%s</h1>%s</body></html>";
+    httpd_req_t *m_req;
+    char m_buffer[HTTP_CHUNK_SIZE];
+    size_t m_length = 0;
 
-    char *buffer = (char *)calloc(512 + strlen(body), 1);
-    sprintf(buffer, format, CFG_STR("STATION.NAME"), body);
-    httpd_resp_sendstr(req, buffer);
-    free(buffer);
+  public:
+    HttpResponse(httpd_req_t *req) : m_req(req) {}
+
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t *data, size_t size)
+    {
+        for (size_t left = size; left > 0;) {
+            size_t count = std::min(left, sizeof(m_buffer) - m_length);
+            memcpy(m_buffer + m_length, data, count);
+            m_length += count;
+            data += count;
+            left -= count;
+            if (m_length == sizeof(m_buffer)) flush();
+        }
+        return size;
+    }
+    using Print::write;
+
+    void flush()
+    {
+        if (m_length > 0 && !getWriteError()) {
+            if (httpd_resp_send_chunk(m_req, m_buffer, m_length) != ESP_OK) {
+                setWriteError(); // The client went away, drop the rest
+            }
+        }
+        m_length = 0;
+    }
+
+    void end()
+    {
+        flush();
+        httpd_resp_send_chunk(m_req, NULL, 0);
+    }
+};
+
+
+// Escapes what is printed to it for use as HTML text
+class HtmlEscape : public Print
+{
+    Print &m_out;
+
+  public:
+    HtmlEscape(Print &out) : m_out(out) {}
+
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t *data, size_t size)
+    {
+        const uint8_t *plain = data;
+        for (const uint8_t *c = data; c < data + size; c++) {
+            const char *entity = (*c == '&') ? "&amp;" : (*c == '<') ? "&lt;" : (*c == '>') ? "&gt;" : NULL;
+            if (entity) {
+                m_out.write(plain, c - plain);
+                m_out.write(entity);
+                plain = c + 1;
+            }
+        }
+        m_out.write(plain, data + size - plain);
+        return size;
+    }
+    using Print::write;
+};
+
+
+static void http_response_begin(HttpResponse &response)
+{
+    response.printf("<html><head><meta name=viewport content='width=device-width,initial-scale=0'><style>"
+        "body{font-family:sans-serif}label,input,a{font-size:2em;margin:0 5px}textarea{-moz-tab-size:2;;width:100%%;height:75vh}"
+        "</style></head><body><h1>%s</h1>", CFG_STR(STATION_NAME));
+}
+
+
+static void http_response_end(HttpResponse &response)
+{
+    response.print("</body></html>");
+    response.end();
 
     sleep_timeout = millis() + (120 * 1000);
     ESP_LOGI("SERVER", "Web request received, going to sleep in %lds!", (sleep_timeout - millis()) / 1000);
 }
 
 
+static void http_response(httpd_req_t * req, const char *body)
+{
+    HttpResponse response(req);
+    http_response_begin(response);
+    response.print(body);
+    http_response_end(response);
+}
+
+
 static void startConfigurationServer(bool force_ap = false, bool exclusive = false)
 {
     if (httpd != NULL) {
@@ -225,12 +615,12 @@ static void startConfigurationServer(bool force_ap = false, bool exclusive = fal
         httpd = NULL;
     }
 
-    if (WiFi.status() != WL_CONNECTED && !force_ap && strlen(CFG_STR("wifi.ssid")) > 0) {
+    if (WiFi.status() != WL_CONNECTED && !force_ap && strlen(CFG_STR(WIFI_SSID)) > 0) {
         ESP_LOGI("SERVER", "Starting Configuration server on local wifi");
         Display.printf("Connecting...");
-        WiFi.begin(CFG_STR("wifi.ssid"), CFG_STR("wifi.password"));
+        WiFi.begin(CFG_STR(WIFI_SSID), CFG_STR(WIFI_PASSWORD));
 
-        int timeout = millis() + (CFG_INT("wifi.timeout") * 1000);
+        int timeout = millis() + (CFG_INT(WIFI_TIMEOUT) * 1000);
         while (WiFi.status() != WL_CONNECTED && millis() < timeout) {
             Display.printf(".");
             delay(250);
@@ -246,7 +636,7 @@ static void startConfigurationServer(bool force_ap = false, bool exclusive = fal
     if (WiFi.status() != WL_CONNECTED || force_ap) {
         ESP_LOGI("SERVER", "Starting Configuration server on access point");
         Display.printf("Starting Access Point...");
-        WiFi.beginAP(CFG_STR("station.name"), (char*)"");
+        WiFi.beginAP(CFG_STR(STATION_NAME), (char*)"");
         delay(500);
         ESP_LOGI("SERVER", "Access point started. SSID: %s  IP: %s", WiFi.SSID(), WiFi.localIP());
     }
@@ -256,37 +646,117 @@ static void startConfigurationServer(bool force_ap = false, bool exclusive = fal
     Display.printf("Mode: %s\n", (WiFi.mode() == WL_MODE_STA) ? "Local Client" : "Access point");
 
     auto home_handler = [](httpd_req_t *req) {
-        char *body = (char*)calloc(2048, 1);
+        const char *message = "";
 
         if (req->method == HTTP_POST) {
             char *rcv_buffer = (char*)calloc(req->content_len + 2, 1);
             char *cfg_buffer = (char*)calloc(req->content_len + 2, 1);
-            httpd_req_recv(req, rcv_buffer, req->content_len + 1);
+            int received = 0;
+            while (received < req->content_len) {
+                int ret = httpd_req_recv(req, rcv_buffer + received, req->content_len - received);
+                if (ret <= 0) {
+                    free(rcv_buffer);
+                    free(cfg_buffer);
+                    return ESP_FAIL;
+                }
+                received += ret;
+            }
             httpd_query_key_value(rcv_buffer, "config", cfg_buffer, req->content_len);
+            free(rcv_buffer);
             urldecode(cfg_buffer);
 
-            if (config.loadJSON(cfg_buffer)) {
+            xSemaphoreTake(config_lock, portMAX_DELAY);
+            bool loaded = config.loadJSON(cfg_buffer);
+            if (loaded) {
                 config.saveNVS(CONFIG_USE_NVS, true);
-                loadConfiguration();
-                strcat(body, "<h2>Configuration saved!</h2>");
+                config.saveRTC();
+            }
+            xSemaphoreGive(config_lock);
+
+            if (loaded) {
+                // A whole new tree, the main task resolves it
+                __atomic_fetch_or(&config_changes, CONFIG_AFFECTS_VALUES, __ATOMIC_SEQ_CST);
+                if (button_event != NULL) {
+                    xSemaphoreGive(button_event);
+                }
+                message = "<h2>Configuration saved!</h2>";
             } else {
-                strcat(body, "<h2>Invalid JSON!</h2>");
+                message = "<h2>Invalid JSON!</h2>";
             }
-            free(rcv_buffer);
             free(cfg_buffer);
         }
 
-        strcat(body, "<form method='post'><textarea name='config'>");
-        strcat(body, config.saveJSON());
-        strcat(body, "</textarea><p><input type='submit' value='Save'> <a href='/restart'>Restart</a></p></form><hr>");
-        strcat(body, "<form action='/upgrade' method='post' enctype='multipart/form-data'><label>Update firmware:</label>");
-        strcat(body, "<input type='file' name='file' style='max-width:50%'><input type='submit' value='Update'></form>");
-        http_response(req, body);
-        free(body);
+        // Everything is streamed, the page can be as large as the configuration gets
+        HttpResponse response(req);
+        HtmlEscape html(response);
+        http_response_begin(response);
+        response.print(message);
+        response.print("<form method='post'><textarea name='config'>");
+        configPrintJSON(html);
+        response.print("</textarea><p><input type='submit' value='Save'> <a href='/restart'>Restart</a></p></form><hr>");
+        response.print("<form action='/upgrade' method='post' enctype='multipart/form-data'><label>Update firmware:</label>");
+        response.print("<input type='file' name='file' style='max-width:50%'><input type='submit' value='Update'></form>");
+        http_response_end(response);
 
         return ESP_OK;
     };
 
+    auto patch_handler = [](httpd_req_t *req) {
+        char content_type[40] = "";
+        httpd_req_get_hdr_value_str(req, "Content-Type", content_type, sizeof(content_type));
+
+        if (strncasecmp(content_type, "application/merge-patch+json", 28) != 0) {
+            httpd_resp_set_status(req, "415 Unsupported Media Type"); // Not in httpd_err_code_t
+            httpd_resp_set_type(req, "text/plain");
+            httpd_resp_sendstr(req, "Expected application/merge-patch+json");
+            return ESP_OK;
+        }
+
+        if (req->content_len == 0 || req->content_len > 4096) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid patch size");
+            return ESP_OK;
+        }
+
+        char *patch = (char*)calloc(req->content_len + 1, 1);
+        int received = 0;
+        while (received < req->content_len) {
+            int ret = httpd_req_recv(req, patch + received, req->content_len - received);
+            if (ret <= 0) {
+                free(patch);
+                return ESP_FAIL;
+            }
+            received += ret;
+        }
+
+        xSemaphoreTake(config_lock, portMAX_DELAY);
+        int changes = config.mergeJSON(patch, onConfigChange);
+        if (changes > 0) {
+            config.saveNVS(CONFIG_USE_NVS, true);
+            config.saveRTC();
+        }
+        xSemaphoreGive(config_lock);
+        free(patch);
+
+        if (changes < 0) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON!");
+            return ESP_OK;
+        }
+
+        char response[32];
+        sprintf(response, "{\"changed\":%d}", changes);
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_sendstr(req, response);
+
+        sleep_timeout = millis() + (120 * 1000);
+        if (changes > 0) {
+            __atomic_fetch_or(&config_changes, CONFIG_AFFECTS_VALUES, __ATOMIC_SEQ_CST);
+            if (button_event != NULL) {
+                xSemaphoreGive(button_event); // The main task applies the changes, it might drop the connection
+            }
+        }
+        return ESP_OK;
+    };
+
     auto upgrade_handler = [](httpd_req_t *req) {
         char* fw_buffer = (char*)malloc(4096);
         int remaining = req->content_len;
@@ -296,11 +766,13 @@ static void startConfigurationServer(bool force_ap = false, bool exclusive = fal
         while (remaining > 0) {
             int ret = httpd_req_recv(req, fw_buffer, min(remaining, 4096));
             if (ret <= 0) {
+                free(fw_buffer);
                 return ESP_FAIL;
             }
 
             if (!FwUpdater.write((uint8_t*)fw_buffer, ret)) {
                 ESP_LOGE("Upload", "Firmware update: Write error (%d bytes)", ret);
+                free(fw_buffer);
                 return ESP_FAIL;
             }
 
@@ -314,6 +786,30 @@ static void startConfigurationServer(bool force_ap = false, bool exclusive = fal
         return ESP_OK;
     };
 
+    // A dashboard polling us gets a 304 until the next poll, this one doesn't extend the sleep timeout
+    auto sensors_handler = [](httpd_req_t *req) {
+        static sensors_snapshot_t snapshot; // Too big for the stack, the server handles one request at a time
+        char etag[40], if_none_match[40] = "";
+        sensorsSnapshot(&snapshot);
+        snprintf(etag, sizeof(etag), "\"%x-%x-%x\"", wake_count, snapshot.generation, snapshot.queue_len);
+        httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match));
+
+        httpd_resp_set_hdr(req, "ETag", etag);
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+        if (strcmp(if_none_match, etag) == 0) {
+            httpd_resp_set_status(req, "304 Not Modified");
+            httpd_resp_send(req, NULL, 0);
+            return ESP_OK;
+        }
+
+        HttpResponse response(req);
+        httpd_resp_set_type(req, "application/json");
+        sensorsPrintJSON(response, &snapshot);
+        response.end();
+        return ESP_OK;
+    };
+
     auto restart_handler = [](httpd_req_t *req) {
         http_response(req, "Goodbye!");
         delay(500);
@@ -324,12 +820,14 @@ static void startConfigurationServer(bool force_ap = false, bool exclusive = fal
     httpd_uri_t handlers[] = {
         {"/", HTTP_GET, home_handler, NULL},
         {"/", HTTP_POST, home_handler, NULL},
-        {"/sensors", HTTP_GET, home_handler, NULL},
+        {"/sensors", HTTP_GET, sensors_handler, NULL},
+        {"/config", HTTP_PATCH, patch_handler, NULL},
         {"/upgrade", HTTP_POST, upgrade_handler, NULL},
         {"/restart", HTTP_GET, restart_handler, NULL},
     };
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.stack_size = HTTP_SERVER_STACK;
     if (httpd_start(&httpd, &config) == ESP_OK) {
         for (int i = 0; i < (sizeof(handlers) / sizeof(httpd_uri_t)); i++) {
             httpd_register_uri_handler(httpd, &handlers[i]);
@@ -345,119 +843,371 @@ static void startConfigurationServer(bool force_ap = false, bool exclusive = fal
     }
 
     while (exclusive && sleep_timeout > millis()) {
-        if (debounceButton(ACTION_BUTTON_PIN, LOW, 1000)) {
+        if (waitButton(sleep_timeout) && debounceButton(ACTION_BUTTON_PIN, LOW, 1000)) {
             startConfigurationServer(!force_ap, exclusive);
             break;
         }
+        if (config_changes) {
+            applyConfigChanges();
+        }
+    }
+}
+
+
+static size_t messageSize(const uint8_t *record)
+{
+    if (message_queue_mode != 0) {
+        return sizeof(aggregate_t);
+    }
+    const message_t *item = (const message_t *)record;
+    size_t size = sizeof(message_t) + __builtin_popcount(item->sensors_present) * sizeof(float);
+    return (size + 7) & ~7;
+}
+
+
+// Remove the oldest bytes of the queue, they must end on a record boundary
+static void messageQueueDiscard(size_t bytes)
+{
+    memmove(message_queue, message_queue + bytes, message_queue_len - bytes);
+    message_queue_len -= bytes;
+}
+
+
+// Records only carry what changed, once one is lost the receiver needs every sensor again
+static void messageQueueLost()
+{
+    memset(sensors_reported_time, 0, sizeof(sensors_reported_time));
+}
+
+
+static uint8_t *messageQueueAlloc(size_t size)
+{
+    while (message_queue_len + size > MESSAGE_QUEUE_BYTES) {
+        ESP_LOGW(__func__, "Queue full, dropping the oldest entry");
+        messageQueueDiscard(messageSize(message_queue));
+        messageQueueLost();
+    }
+    uint8_t *record = message_queue + message_queue_len;
+    message_queue_len += size;
+    memset(record, 0, size);
+    return record;
+}
+
+
+static void queueSensorsData()
+{
+    int64_t now = uptime();
+    int8_t mode = CFG_INT(HTTP_UPDATE_AGGREGATE) > 0 ? 1 : 0;
+
+    if (mode != message_queue_mode) {
+        ESP_LOGW(__func__, "Aggregation mode changed, clearing the queue");
+        message_queue_len = 0;
+        message_queue_mode = mode;
+        messageQueueLost();
+    }
+
+    if (message_queue_mode == 0) {
+        int64_t heartbeat = CFG_INT(HTTP_UPDATE_HEARTBEAT) * 1000LL;
+        float values[SENSORS_COUNT];
+        uint32_t status = 0, present = 0;
+        int count = 0;
+
+        for (int i = 0; i < SENSORS_COUNT; i++) {
+            float value = SENSORS[i].val, last = sensors_reported[i];
+            float deadband = fmaxf(SENSORS_DEF[i].deadband_abs, SENSORS_DEF[i].deadband_rel * fabsf(last));
+
+            if (SENSORS[i].status != SENSOR_OK) {
+                sensors_reported_time[i] = 0; // Report it as soon as it's back
+                status |= (1 << i);
+            }
+            else if (sensors_reported_time[i] == 0 || now - sensors_reported_time[i] >= heartbeat
+                    || fabsf(value - last) > deadband * CFG_DBL(SENSORS_DEADBAND_SCALE)) {
+                sensors_reported[i] = value;
+                sensors_reported_time[i] = now;
+                values[count++] = value;
+                present |= (1 << i);
+            }
+        }
+
+        message_t *item = (message_t *)messageQueueAlloc((sizeof(message_t) + count * sizeof(float) + 7) & ~7);
+        item->uptime = now;
+        item->sensors_status = status;
+        item->sensors_present = present;
+        memcpy(item + 1, values, count * sizeof(float));
+        ESP_LOGI(__func__, "Queued %d of %d sensors, %d bytes used", count, SENSORS_COUNT, message_queue_len);
+        return;
+    }
+
+    // Fold the sample into the current interval, open a new one once it's over
+    aggregate_t *item = NULL;
+    if (message_queue_len > 0) {
+        item = (aggregate_t *)(message_queue + message_queue_len - sizeof(aggregate_t));
+    }
+    if (item == NULL || now - item->start >= CFG_INT(HTTP_UPDATE_INTERVAL) * 1000LL) {
+        item = (aggregate_t *)messageQueueAlloc(sizeof(aggregate_t));
+        item->start = now;
+    }
+    item->uptime = now;
+    item->samples++;
+    item->sensors_status = 0;
+
+    for (int i = 0; i < SENSORS_COUNT; i++) {
+        float value = SENSORS[i].val;
+        if (SENSORS[i].status == SENSOR_OK) {
+            if (item->count[i]++ == 0) {
+                item->mean[i] = item->min[i] = item->max[i] = value;
+            } else {
+                item->mean[i] += (value - item->mean[i]) / item->count[i];
+                if (value < item->min[i]) item->min[i] = value;
+                if (value > item->max[i]) item->max[i] = value;
+            }
+            item->last[i] = value;
+        }
+        if (item->count[i] == 0) {
+            item->sensors_status |= (1 << i);
+        }
     }
 }
 
 
+// Serialize one queue record as an InfluxDB line
+static void influxFrame(const uint8_t *record, char *frame)
+{
+    int level = CFG_INT(HTTP_UPDATE_AGGREGATE);
+
+    if (message_queue_mode == 0) {
+        const message_t *item = (const message_t *)record;
+        const float *values = (const float *)(item + 1);
+        sprintf(frame, "%s_sensors,station=%s status=%u",
+            CFG_STR(STATION_GROUP), CFG_STR(STATION_NAME), item->sensors_status);
+        for (int j = 0; j < SENSORS_COUNT; j++) {
+            if (item->sensors_present & (1 << j)) {
+                sprintf(frame + strlen(frame), ",%s=%.4f", SENSORS_DEF[j].key, *values++);
+            }
+        }
+        sprintf(frame + strlen(frame), " %llu\n", first_boot_time + item->uptime);
+        return;
+    }
+
+    const aggregate_t *item = (const aggregate_t *)record;
+    sprintf(frame, "%s_sensors,station=%s status=%u,samples=%u",
+        CFG_STR(STATION_GROUP), CFG_STR(STATION_NAME), item->sensors_status, item->samples);
+    for (int j = 0; j < SENSORS_COUNT; j++) {
+        const char *key = SENSORS_DEF[j].key;
+        if (item->count[j] == 0) {
+            continue;
+        }
+        sprintf(frame + strlen(frame), ",%s=%.4f", key, item->mean[j]);
+        if (level >= 2) {
+            sprintf(frame + strlen(frame), ",%s_min=%.4f,%s_max=%.4f", key, item->min[j], key, item->max[j]);
+        }
+        if (level >= 3) {
+            sprintf(frame + strlen(frame), ",%s_last=%.4f,%s_count=%u", key, item->last[j], key, item->count[j]);
+        }
+    }
+    sprintf(frame + strlen(frame), " %llu\n", first_boot_time + item->uptime);
+}
+
+
+// Serialize one queue record as a JSON object
+static cJSON *jsonFrame(const uint8_t *record)
+{
+    int level = CFG_INT(HTTP_UPDATE_AGGREGATE);
+    cJSON *entry = cJSON_CreateObject();
+
+    if (message_queue_mode == 0) {
+        const message_t *item = (const message_t *)record;
+        const float *values = (const float *)(item + 1);
+        cJSON_AddNumberToObject(entry, "time", first_boot_time + item->uptime);
+        cJSON_AddNumberToObject(entry, "offset", uptime() - item->uptime);
+        cJSON_AddNumberToObject(entry, "status", item->sensors_status);
+        cJSON_AddNumberToObject(entry, "present", item->sensors_present);
+        for (int i = 0; i < SENSORS_COUNT; i++) {
+            if (item->sensors_present & (1 << i)) {
+                cJSON_AddNumberToObject(entry, SENSORS_DEF[i].key, F2D(*values++));
+            } else if (item->sensors_status & (1 << i)) {
+                cJSON_AddNullToObject(entry, SENSORS_DEF[i].key);
+            } // Unchanged values are left out
+        }
+        return entry;
+    }
+
+    const aggregate_t *item = (const aggregate_t *)record;
+    cJSON_AddNumberToObject(entry, "time", first_boot_time + item->uptime);
+    cJSON_AddNumberToObject(entry, "offset", uptime() - item->uptime);
+    cJSON_AddNumberToObject(entry, "duration", item->uptime - item->start);
+    cJSON_AddNumberToObject(entry, "status", item->sensors_status);
+    cJSON_AddNumberToObject(entry, "samples", item->samples);
+    for (int i = 0; i < SENSORS_COUNT; i++) {
+        if (item->count[i] == 0) {
+            cJSON_AddNullToObject(entry, SENSORS_DEF[i].key);
+        } else if (level == 1) {
+            cJSON_AddNumberToObject(entry, SENSORS_DEF[i].key, F2D(item->mean[i]));
+        } else {
+            cJSON *summary = cJSON_AddObjectToObject(entry, SENSORS_DEF[i].key);
+            cJSON_AddNumberToObject(summary, "mean", F2D(item->mean[i]));
+            cJSON_AddNumberToObject(summary, "min", F2D(item->min[i]));
+            cJSON_AddNumberToObject(summary, "max", F2D(item->max[i]));
+            if (level >= 3) {
+                cJSON_AddNumberToObject(summary, "last", F2D(item->last[i]));
+                cJSON_AddNumberToObject(summary, "count", item->count[i]);
+            }
+        }
+    }
+    return entry;
+}
+
+
 static void httpPushData()
 {
     char url[512] = "";
     char content_type[40] = "application/binary";
-    char buffer[2048] = "";
+    char buffer[4096] = "";
+    char *body = buffer;
+    size_t sent = 0; // Queue bytes included in this request
+    int64_t now = uptime();
     int count = 0;
 
-    if (strcasecmp(CFG_STR("http.update.type"), "InfluxDB") == 0)
+    if (strcasecmp(CFG_STR(HTTP_UPDATE_TYPE), "InfluxDB") == 0)
     {
-        sprintf(url, "%s/write?db=%s&precision=ms", CFG_STR("http.update.url"), CFG_STR("http.update.database"));
-
-        for (int i = 0; i < MESSAGE_QUEUE_SIZE; i++) {
-            message_t *item = &message_queue[i];
-
-            if (item->uptime > 0) {
-                sprintf(buffer + strlen(buffer),
-                    "%s_sensors,station=%s status=%u",
-                    CFG_STR("STATION.GROUP"),
-                    CFG_STR("STATION.NAME"),
-                    item->sensors_status
-                );
-
-                for (int j = 0; j < SENSORS_COUNT; j++) {
-                    if ((item->sensors_status & (1 << j)) == 0) {
-                        sprintf(buffer + strlen(buffer), ",%s=%.4f", SENSORS[j].key, item->sensors_data[j]);
-                    }
-                }
+        char frame[1536];
+
+        sprintf(url, "%s/write?db=%s&precision=ms", CFG_STR(HTTP_UPDATE_URL), CFG_STR(HTTP_UPDATE_DATABASE));
+
+        while (sent < message_queue_len) {
+            influxFrame(message_queue + sent, frame);
+            if (strlen(buffer) + strlen(frame) >= sizeof(buffer) - (SENSORS_COUNT * 100 + 768)) { // Keep room for the stats and status lines
+                ESP_LOGW(__func__, "HTTP: Buffer full, remaining frames will be sent next time");
+                break;
+            }
+            strcat(buffer, frame);
+            sent += messageSize(message_queue + sent);
+            count++;
+        }
 
-                sprintf(buffer + strlen(buffer), " %llu\n", first_boot_time + item->uptime);
-                count++;
+        size_t stats_start = strlen(buffer);
+        sprintf(buffer + stats_start, "%s_stats,station=%s ", CFG_STR(STATION_GROUP), CFG_STR(STATION_NAME));
+        for (int j = 0; j < SENSORS_COUNT; j++) {
+            const sensor_stats_t *stats = &SENSORS[j].stats;
+            if (stats->n > 0) {
+                sprintf(buffer + strlen(buffer), "%s_avg=%.4f,%s_dev=%.4f,%s_ewma=%.4f,%s_min=%.4f,%s_max=%.4f,",
+                    SENSORS_DEF[j].key, statsWindowMean(stats),
+                    SENSORS_DEF[j].key, statsStdDev(stats),
+                    SENSORS_DEF[j].key, stats->ewma,
+                    SENSORS_DEF[j].key, statsRolling(stats, now, false),
+                    SENSORS_DEF[j].key, statsRolling(stats, now, true));
             }
         }
+        if (buffer[strlen(buffer) - 1] == ',') {
+            sprintf(buffer + strlen(buffer) - 1, " %llu\n", first_boot_time + now);
+        } else {
+            buffer[stats_start] = 0; // No stats yet
+        }
 
         sprintf(buffer + strlen(buffer),
-            "%s_status,station=%s,version=%s,build=%s ntp_delta=%lld,data_points=%d,power_save=0,cycles=%d,uptime=%llu %llu",
-            CFG_STR("STATION.GROUP"),
-            CFG_STR("STATION.NAME"),
+            "%s_status,station=%s,version=%s,build=%s ntp_delta=%lld,data_points=%d,power_save=0,cycles=%d,uptime=%llu",
+            CFG_STR(STATION_GROUP),
+            CFG_STR(STATION_NAME),
             PROJECT_VERSION,
             esp_app_desc.version,
             ntp_time_delta,
             count,
             wake_count,
-            uptime(),
-            boot_time()
+            uptime()
         );
+        if (memory_last_free > 0) {
+            sprintf(buffer + strlen(buffer), ",heap_leak=%d,heap_low=%u", memory_last_leak, memory_last_free);
+            for (int i = 0; i < MEMORY_PHASE_COUNT; i++) {
+                if (memory_last_wake[i].ran) {
+                    sprintf(buffer + strlen(buffer), ",heap_%s=%d,heap_%s_peak=%u",
+                        MEMORY_PHASE_NAMES[i], memory_last_wake[i].net_bytes,
+                        MEMORY_PHASE_NAMES[i], memory_last_wake[i].peak * 1024);
+                }
+            }
+        }
+        sprintf(buffer + strlen(buffer), " %llu", boot_time());
     }
     else
     {
-        sprintf(url, "%s", CFG_STR("http.update.url"));
+        sprintf(url, "%s", CFG_STR(HTTP_UPDATE_URL));
         strcpy(content_type, "application/json");
 
         cJSON *json = cJSON_CreateObject();
-        cJSON_AddStringToObject(json, "station", CFG_STR("STATION.NAME"));
-        cJSON_AddStringToObject(json, "group", CFG_STR("STATION.GROUP"));
+        cJSON_AddStringToObject(json, "station", CFG_STR(STATION_NAME));
+        cJSON_AddStringToObject(json, "group", CFG_STR(STATION_GROUP));
         cJSON_AddStringToObject(json, "version", PROJECT_VERSION);
         cJSON_AddStringToObject(json, "build", esp_app_desc.version);
         cJSON_AddNumberToObject(json, "uptime", uptime());
         cJSON_AddNumberToObject(json, "cycles", wake_count);
         cJSON_AddNumberToObject(json, "ntp_delta", ntp_time_delta);
+        cJSON_AddNumberToObject(json, "aggregate", message_queue_mode ? CFG_INT(HTTP_UPDATE_AGGREGATE) : 0);
+        if (memory_last_free > 0) { // Previous wake
+            cJSON *memory = cJSON_AddObjectToObject(json, "memory");
+            cJSON_AddNumberToObject(memory, "leak", memory_last_leak);
+            cJSON_AddNumberToObject(memory, "low", memory_last_free);
+            for (int i = 0; i < MEMORY_PHASE_COUNT; i++) {
+                if (memory_last_wake[i].ran) {
+                    cJSON *phase = cJSON_AddObjectToObject(memory, MEMORY_PHASE_NAMES[i]);
+                    cJSON_AddNumberToObject(phase, "bytes", memory_last_wake[i].net_bytes);
+                    cJSON_AddNumberToObject(phase, "blocks", memory_last_wake[i].net_blocks);
+                    cJSON_AddNumberToObject(phase, "peak", memory_last_wake[i].peak * 1024);
+                }
+            }
+        }
         cJSON *data = cJSON_AddArrayToObject(json, "data");
 
-        for (int i = 0; i < MESSAGE_QUEUE_SIZE; i++) {
-            message_t *item = &message_queue[i];
-
-            if (item->uptime == 0) {
-                cJSON *entry = cJSON_CreateObject();
-                cJSON_AddNumberToObject(entry, "time", first_boot_time + item->uptime);
-                cJSON_AddNumberToObject(entry, "offset", uptime() - item->uptime);
-                cJSON_AddNumberToObject(entry, "status", item->sensors_status);
-                for (int i = 0; i < SENSORS_COUNT; i++) {
-                    if ((item->sensors_status & (1 << i)) == 0) {
-                        cJSON_AddNumberToObject(entry, SENSORS[i].key, F2D(item->sensors_data[i]));
-                    } else {
-                        cJSON_AddNullToObject(entry, SENSORS[i].key); // Or maybe send nothing at all?
-                    }
-                }
-                cJSON_AddItemToArray(data, entry);
-                count++;
+        while (sent < message_queue_len) {
+            cJSON_AddItemToArray(data, jsonFrame(message_queue + sent));
+            sent += messageSize(message_queue + sent);
+            count++;
+        }
+
+        cJSON *stats = cJSON_AddObjectToObject(json, "stats");
+        for (int i = 0; i < SENSORS_COUNT; i++) {
+            const sensor_stats_t *sensor_stats = &SENSORS[i].stats;
+            if (sensor_stats->n > 0) {
+                cJSON *entry = cJSON_AddObjectToObject(stats, SENSORS_DEF[i].key);
+                cJSON_AddNumberToObject(entry, "avg", F2D(statsWindowMean(sensor_stats)));
+                cJSON_AddNumberToObject(entry, "dev", F2D(statsStdDev(sensor_stats)));
+                cJSON_AddNumberToObject(entry, "ewma", F2D(sensor_stats->ewma));
+                cJSON_AddNumberToObject(entry, "min", F2D(statsRolling(sensor_stats, now, false)));
+                cJSON_AddNumberToObject(entry, "max", F2D(statsRolling(sensor_stats, now, true)));
+                cJSON_AddNumberToObject(entry, "count", sensor_stats->n);
             }
         }
 
-        cJSON_PrintPreallocated(json, buffer, sizeof(buffer), false);
-        cJSON_free(json);
+        body = cJSON_PrintUnformatted(json);
+        cJSON_Delete(json);
+        if (body == NULL) {
+            ESP_LOGE(__func__, "HTTP: Not enough memory to serialize %d data frame(s)", count);
+            return;
+        }
     }
 
     ESP_LOGI(__func__, "HTTP: Sending %d data frame(s) to '%s'...", count, url);
-    ESP_LOGI(__func__, "HTTP: Body: '%s'", buffer);
+    ESP_LOGI(__func__, "HTTP: Body: '%s'", body);
     Display.printf("\nHTTP POST...");
 
     esp_http_client_config_t http_config = {};
 
     http_config.url        = url;
     http_config.method     = HTTP_METHOD_POST;
-    http_config.timeout_ms = CFG_INT("http.timeout") * 1000;
-    if (strlen(CFG_STR("http.update.username")) > 0) {
-        http_config.username   = CFG_STR("http.update.username");
-        http_config.password   = CFG_STR("http.update.password");
+    http_config.timeout_ms = CFG_INT(HTTP_TIMEOUT) * 1000;
+    if (strlen(CFG_STR(HTTP_UPDATE_USERNAME)) > 0) {
+        http_config.username   = CFG_STR(HTTP_UPDATE_USERNAME);
+        http_config.password   = CFG_STR(HTTP_UPDATE_PASSWORD);
         http_config.auth_type  = HTTP_AUTH_TYPE_BASIC;
     }
 
     esp_http_client_handle_t client = esp_http_client_init(&http_config);
     esp_http_client_set_header(client, "Content-Type", content_type);
-    esp_http_client_set_post_field(client, buffer, strlen(buffer));
+    esp_http_client_set_post_field(client, body, strlen(body));
     esp_err_t err = esp_http_client_perform(client);
 
+    if (body != buffer) {
+        cJSON_free(body);
+    }
+
     int httpCode = -1, length = -1;
     if (err == ESP_OK) {
         httpCode = esp_http_client_get_status_code(client);
@@ -468,7 +1218,9 @@ static void httpPushData()
     if (httpCode == 200 || httpCode == 204) {
         ESP_LOGI(__func__, "HTTP: Received code: %d  Body: '%s'", httpCode, buffer);
         Display.printf("OK (%d)", httpCode);
-        memset(message_queue, 0, sizeof(message_queue)); // Request successful, clear items from queue!
+        sensorsLock();
+        messageQueueDiscard(sent); // Request successful, clear sent items from queue!
+        sensorsUnlock();
     }
     else if (httpCode > 0) {
         ESP_LOGW(__func__, "HTTP: Received code: %d  Body: '%s'", httpCode, buffer);
@@ -481,12 +1233,14 @@ static void httpPushData()
 
     esp_http_client_cleanup(client);
 
-    int interval = POWER_SAVE_INTERVAL(CFG_INT("http.update.interval"), CFG_DBL("powersave.threshold"), getSensor("bat")->avg);
-    if (interval < CFG_INT("http.update.interval")) {
+    int interval = POWER_SAVE_INTERVAL(CFG_INT(HTTP_UPDATE_INTERVAL), CFG_DBL(POWERSAVE_THRESHOLD), statsWindowMean(&SENSORS[SENSOR_ID_BAT].stats));
+    if (interval < CFG_INT(HTTP_UPDATE_INTERVAL)) {
         ESP_LOGW(__func__, "Power saving enabled, HTTP update interval increased to %ds", interval);
     }
 
+    sensorsLock();
     next_http_update = boot_time() + (interval * 1000);
+    sensorsUnlock();
 }
 
 
@@ -495,7 +1249,10 @@ extern "C" void app_main()
     printf("\n################### WEATHER STATION (Version: %s) ###################\n\n", PROJECT_VERSION);
     ESP_LOGI("Build", "%s (%s %s)", esp_app_desc.version, esp_app_desc.date, esp_app_desc.time);
     ESP_LOGI("Uptime", "%llu seconds (Cycles: %d)", uptime() / 1000, wake_count);
-    PRINT_MEMORY_STATS(); const esp_partition_t *partition = esp_ota_get_running_partition();
+    sensors_lock = xSemaphoreCreateMutex();
+    config_lock = xSemaphoreCreateMutex();
+    memoryPhase(MEMORY_PHASE_BOOT);
+    const esp_partition_t *partition = esp_ota_get_running_partition();
     ESP_LOGI("Partition", "'%s', offset: 0x%x", partition->label, partition->address);
 
     if (wake_count++ == 0) {
@@ -517,21 +1274,26 @@ extern "C" void app_main()
     rtc_gpio_pulldown_dis((gpio_num_t)ACTION_BUTTON_PIN);
     rtc_gpio_pullup_en((gpio_num_t)ACTION_BUTTON_PIN);
 
-    loadConfiguration();
+    loadConfiguration(esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER);
 
     Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN);
-    Display.begin();
-    Display.printf("# %s #\n", CFG_STR("STATION.NAME"));
+    if (is_interactive_wakeup) {
+        Display.begin();
+    } else {
+        Display.beginHeadless();
+    }
+    Display.printf("# %s #\n", CFG_STR(STATION_NAME));
     Display.printf("# Up: %lld minutes #\n", uptime() / 60000);
 
     // Check if we detect a long press
     if (debounceButton(ACTION_BUTTON_PIN, LOW, 2500)) {
+        memoryPhase(MEMORY_PHASE_SERVER);
         startConfigurationServer(false, true);
     }
 
     // Main task
-    char*wifi_ssid = CFG_STR("wifi.ssid"), *wifi_password = CFG_STR("wifi.password");
-    long wifi_available = strlen(wifi_ssid) > 0, wifi_timeout = millis() + CFG_INT("wifi.timeout") * 1000;
+    char*wifi_ssid = CFG_STR(WIFI_SSID), *wifi_password = CFG_STR(WIFI_PASSWORD);
+    long wifi_available = strlen(wifi_ssid) > 0, wifi_timeout = millis() + CFG_INT(WIFI_TIMEOUT) * 1000;
     bool use_network = wifi_available && rtc_millis() >= (next_http_update - 5000);
 
     if (!wifi_available) {
@@ -544,18 +1306,16 @@ extern "C" void app_main()
     }
 
     // Poll sensors while wifi connects
+    memoryPhase(MEMORY_PHASE_SENSORS);
     pollSensors();
 
     // Add sensors data to message (HTTP) queue
-    message_t *item = &message_queue[message_queue_pos];
-    item->uptime = uptime();
-    for (int i = 0; i < SENSORS_COUNT; i++) {
-        item->sensors_data[i] = SENSORS[i].val;
-        item->sensors_status |= ((SENSORS[i].status ? 1 : 0) << i);
-    }
-    message_queue_pos = (message_queue_pos + 1) % MESSAGE_QUEUE_SIZE;
+    sensorsLock();
+    queueSensorsData();
+    sensorsUnlock();
 
     // Now do the http request!
+    memoryPhase(MEMORY_PHASE_NETWORK);
     if (use_network) {
         Display.printf("\n");
         while (WiFi.status() != WL_CONNECTED && millis() < wifi_timeout) {
@@ -578,7 +1338,7 @@ extern "C" void app_main()
             // Start the config server allowing for a remote access
             startConfigurationServer();
             // Then push all our sensors data over HTTP
-            if (strlen(CFG_STR("http.update.url")) > 0) {
+            if (strlen(CFG_STR(HTTP_UPDATE_URL)) > 0) {
                 httpPushData();
             }
         }
@@ -588,19 +1348,48 @@ extern "C" void app_main()
         }
     }
 
-    // Display sensors again
-    displaySensors();
+    // Display sensors again, live if someone is watching
+    memoryPhase(MEMORY_PHASE_IDLE);
+    int refresh_interval = CFG_INT(STATION_DISPLAY_REFRESH);
+    bool live = is_interactive_wakeup && Display.isPresent() && refresh_interval > 0;
+
+    if (live) {
+        ulp_wind_live_start(); // Finer live wind, the ULP gets the pin back in hibernate()
+        Display.lock();
+        dashboard_active = !firmware_upgrading;
+        if (dashboard_active) displayDashboard(false);
+        Display.unlock();
+    } else if (!firmware_upgrading) {
+        displaySensors();
+    }
 
     // Keep the screen and server active for a while
-    sleep_timeout = (is_interactive_wakeup ? 15 : CFG_INT("STATION.SLEEP_DELAY")) * 1000;
+    sleep_timeout = (is_interactive_wakeup ? 15 : CFG_INT(STATION_SLEEP_DELAY)) * 1000;
 
     if (sleep_timeout > millis()) {
         ESP_LOGI(__func__, "Going to sleep in %ldms", sleep_timeout - millis());
+        unsigned long next_refresh = millis() + refresh_interval;
         while (sleep_timeout > millis()) {
-            if (debounceButton(ACTION_BUTTON_PIN, LOW, 100)) {
-                while (digitalRead(ACTION_BUTTON_PIN) == LOW); // Debounce
+            unsigned long deadline = live ? std::min((unsigned long)sleep_timeout, next_refresh) : sleep_timeout;
+            if (waitButton(deadline) && debounceButton(ACTION_BUTTON_PIN, LOW, 100)) {
+                while (digitalRead(ACTION_BUTTON_PIN) == LOW) {
+                    delay(10); // Wait for the release
+                }
                 break;
             }
+            if (config_changes) {
+                applyConfigChanges();
+            }
+            // Sensors and display share the I2C bus, both are done here one after the other
+            if (live && !dashboard_active) {
+                live = false; // A firmware upgrade took the display
+            }
+            if (live && millis() >= next_refresh) {
+                Display.lock();
+                if (dashboard_active) displayDashboard(true);
+                Display.unlock();
+                next_refresh = millis() + refresh_interval;
+            }
         }
     }
 
@@ -0,0 +1,114 @@
+#include <esp_heap_caps.h>
+#if MEMORY_TRACE_LEAKS
+#include <esp_heap_trace.h>
+#endif
+
+// Phases of a wake, in the order app_main() goes through them
+#define MEMORY_PHASES(X) \
+    X(BOOT,     "boot")     \
+    X(SERVER,   "server")   /* Exclusive configuration server (long press) */ \
+    X(SENSORS,  "sensors")  \
+    X(NETWORK,  "network")  \
+    X(IDLE,     "idle")     /* Dashboard and configuration server until we sleep */
+
+#define MEMORY_PHASE_ID(id, name) MEMORY_PHASE_##id,
+#define MEMORY_PHASE_NAME(id, name) name,
+enum { MEMORY_PHASES(MEMORY_PHASE_ID) MEMORY_PHASE_COUNT };
+static const char *MEMORY_PHASE_NAMES[] = { MEMORY_PHASES(MEMORY_PHASE_NAME) };
+
+// Heap accounting of one phase. Allocations made by other tasks (httpd, wifi) count towards the active phase.
+typedef struct {
+    int32_t net_bytes;  // Allocated at the end minus at the start, what a phase keeps is either a leak or a cache
+    int16_t net_blocks; // Same in number of allocations
+    uint16_t peak;      // Highest heap usage seen during the phase in KB (a lower bound if it didn't set a new low-water mark)
+    uint8_t ran;
+} memory_phase_stats_t;
+
+// The complete report of the previous wake, sent with the status of the next upload
+RTC_DATA_ATTR static memory_phase_stats_t memory_last_wake[MEMORY_PHASE_COUNT];
+RTC_DATA_ATTR static int32_t memory_last_leak = 0; // Bytes still allocated when the previous wake went to sleep
+RTC_DATA_ATTR static uint32_t memory_last_free = 0; // Heap low-water mark of the previous wake
+
+static memory_phase_stats_t memory_phases[MEMORY_PHASE_COUNT];
+static multi_heap_info_t memory_phase_start;
+static size_t memory_wake_start = 0;
+static int memory_phase = -1;
+
+#if MEMORY_TRACE_LEAKS
+static heap_trace_record_t memory_trace[MEMORY_TRACE_LEAKS];
+#endif
+
+
+static void memoryPhaseEnd()
+{
+    if (memory_phase < 0) {
+        return;
+    }
+
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_DEFAULT);
+
+    // The low-water mark is global, we only know the peak exactly when this phase lowered it
+    size_t total = info.total_allocated_bytes + info.total_free_bytes;
+    size_t peak = std::max(memory_phase_start.total_allocated_bytes, info.total_allocated_bytes);
+    if (info.minimum_free_bytes < memory_phase_start.minimum_free_bytes) {
+        peak = total - info.minimum_free_bytes;
+    }
+
+    memory_phase_stats_t *stats = &memory_phases[memory_phase];
+    stats->net_bytes += (int32_t)info.total_allocated_bytes - (int32_t)memory_phase_start.total_allocated_bytes;
+    stats->net_blocks += (int16_t)(info.allocated_blocks - memory_phase_start.allocated_blocks);
+    stats->peak = std::max<uint16_t>(stats->peak, peak / 1024);
+    stats->ran = 1;
+
+    ESP_LOGI("Memory", "Phase %s: %+d bytes in %+d blocks, peak %u KB, free %u KB",
+        MEMORY_PHASE_NAMES[memory_phase], stats->net_bytes, stats->net_blocks, stats->peak,
+        (unsigned)(info.total_free_bytes / 1024));
+
+#if MEMORY_TRACE_LEAKS
+    heap_trace_stop();
+    if (stats->net_blocks > 0) {
+        heap_trace_dump(); // What the phase allocated and didn't free, with callers
+    }
+#endif
+
+    memory_phase = -1;
+}
+
+
+// Closes the current phase and opens the next one. Phases are taken from app_main()'s task only.
+static void memoryPhase(int phase)
+{
+    memoryPhaseEnd();
+
+    heap_caps_get_info(&memory_phase_start, MALLOC_CAP_DEFAULT);
+    if (phase == MEMORY_PHASE_BOOT) {
+        memory_wake_start = memory_phase_start.total_allocated_bytes;
+#if MEMORY_TRACE_LEAKS
+        heap_trace_init_standalone(memory_trace, MEMORY_TRACE_LEAKS);
+#endif
+    }
+    memory_phase = phase;
+
+#if MEMORY_TRACE_LEAKS
+    heap_trace_start(HEAP_TRACE_LEAKS);
+#endif
+}
+
+
+// Called before sleeping, keeps this wake's report for the next upload
+static void memoryReport()
+{
+    memoryPhaseEnd();
+
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_DEFAULT);
+
+    memcpy(memory_last_wake, memory_phases, sizeof(memory_phases));
+    memory_last_leak = (int32_t)info.total_allocated_bytes - (int32_t)memory_wake_start;
+    memory_last_free = info.minimum_free_bytes;
+
+    ESP_LOGI("Memory", "Wake: %+d bytes never freed, used %u KB, free %u KB, lowest free %u KB",
+        memory_last_leak, (unsigned)(info.total_allocated_bytes / 1024), (unsigned)(info.total_free_bytes / 1024),
+        (unsigned)(info.minimum_free_bytes / 1024));
+}
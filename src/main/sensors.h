@@ -1,21 +1,19 @@
-#include "Adafruit_ADS1015.h"
-#include "Adafruit_BME280.h"
-#include "BMP180.h"
-#include "DHT.h"
+// Static description of a sensor, known at compile time
+typedef struct {
+    const char *key;  // Sensor key used when serializing
+    const char *unit; //
+    const char *desc; //
+    short nsamples;   // Window of the average, at most STATS_WINDOW_MAX
+    uint8_t attr;     // Linked sensor attribute (4 bits sensor type, 4 bits attribute number)
+    float deadband_abs; // Smallest change worth reporting, in unit
+    float deadband_rel; // Same but relative to the last reported value (0.01 = 1%)
+} SENSOR_DEF_t;
 
-#define SENSOR(key, unit, desc, avgr, attr) {key, unit, desc, 1, avgr, 0, 0.00, 0.00, 0.00, 0.00, attr}
+// Runtime state of a sensor, kept in RTC memory
 typedef struct {
-    char key[8];      // Sensor key used when serializing
-    char unit[4];     //
-    char desc[16];    //
     short status;     // Status
-    short nsamples;   // Used in avg calculation
-    short count;      //
-    float min;        // All time min
-    float max;        // All time max
-    float avg;        // Average value of last nsamples
     float val;        // Current value
-    uint8_t attr;     // Linked sensor attribute (4 bits sensor type, 4 bits attribute number)
+    sensor_stats_t stats;
 } SENSOR_t;
 
 #define SENSOR_OK 0
@@ -23,9 +21,6 @@ typedef struct {
 #define SENSOR_ERR_UNKNOWN -1
 #define SENSOR_ERR_TIMEOUT -2
 
-#define SENSOR_ATTR_NOT_SET __FLT_MAX__
-#define SENSOR_ATTR_PENDING __FLT_MIN__
-
 typedef enum {
     SENSOR_NULL = (0 << 4),
     SENSOR_ADC  = (1 << 4),
@@ -37,54 +32,82 @@ typedef enum {
     SENSOR_WIND = (7 << 4),
 } SENSOR_TYPE_t;
 
-RTC_DATA_ATTR SENSOR_t SENSORS[] = {
-    //     ID,     Unit,   Name,       AVGr, Sensor Type|Channel
-    SENSOR("bat",  "V",    "Battery",     5, SENSOR_ADS|0),
-    SENSOR("sol",  "V",    "Solar",      10, SENSOR_ADS|1),
-    SENSOR("l1",   "raw",  "Light 1",    10, SENSOR_ADS|2),
-    SENSOR("l2",   "raw",  "Light 2",    10, SENSOR_ADS|3),
-    SENSOR("t1",   "C",    "Temp 1",     10, SENSOR_DHT|0),
-    SENSOR("t2",   "C",    "Temp 2",     10, SENSOR_BMP|0), // SENSOR_BME(0)
-    SENSOR("h1",   "%",    "Humidity 1", 10, SENSOR_DHT|1),
-    SENSOR("h2",   "%",    "Humidity 2", 10, SENSOR_BME|1),
-    SENSOR("p1",   "kPa",  "Pressure 1", 10, SENSOR_BMP|1),
-    SENSOR("p2",   "kPa",  "Pressure 2", 10, SENSOR_BME|2),
-    SENSOR("ws",   "kmh",  "Wind Speed", 10, SENSOR_WIND|0),
-    SENSOR("wd",   "deg",  "Wind Dir.",  10, SENSOR_WIND|1),
-    SENSOR("rain", "ohm",  "Rain",       10, SENSOR_NULL|0),
-};
-const int SENSORS_COUNT = (sizeof(SENSORS) / sizeof(SENSOR_t));
+#define SENSOR_TYPE(attr) ((attr) & 0xF0)
+#define SENSOR_CHANNEL(attr) ((attr) & 0x0F)
+
+// Columns: Id, Key, Unit, Name, AVGr, Sensor Type|Channel, Deadband (absolute, relative)
+#define SENSORS_LIST(X) \
+    X(BAT,  "bat",  "V",    "Battery",     5, SENSOR_ADS|0,  0.01, 0)      \
+    X(SOL,  "sol",  "V",    "Solar",      10, SENSOR_ADS|1,  0.05, 0)      \
+    X(L1,   "l1",   "raw",  "Light 1",    10, SENSOR_ADS|2,  0.01, 0.02)   \
+    X(L2,   "l2",   "raw",  "Light 2",    10, SENSOR_ADS|3,  0.01, 0.02)   \
+    X(T1,   "t1",   "C",    "Temp 1",     10, SENSOR_DHT|0,  0.1,  0)      \
+    X(T2,   "t2",   "C",    "Temp 2",     10, SENSOR_BMP|0,  0.1,  0)      /* SENSOR_BME|0 */ \
+    X(H1,   "h1",   "%",    "Humidity 1", 10, SENSOR_DHT|1,  1,    0)      \
+    X(H2,   "h2",   "%",    "Humidity 2", 10, SENSOR_BME|1,  1,    0)      \
+    X(P1,   "p1",   "kPa",  "Pressure 1", 10, SENSOR_BMP|1,  0,    0.0005) \
+    X(P2,   "p2",   "kPa",  "Pressure 2", 10, SENSOR_BME|2,  0,    0.0005) \
+    X(WS,   "ws",   "kmh",  "Wind Speed", 10, SENSOR_WIND|0, 0.5,  0)      \
+    X(WD,   "wd",   "deg",  "Wind Dir.",  10, SENSOR_WIND|1, 10,   0)      \
+    X(RAIN, "rain", "ohm",  "Rain",       10, SENSOR_NULL|0, 0,    0.05)
+
+#define SENSOR_ID(id, key, unit, desc, avgr, attr, db, dbr) SENSOR_ID_##id,
+#define SENSOR_DEF(id, key, unit, desc, avgr, attr, db, dbr) {key, unit, desc, avgr, attr, db, dbr},
+#define SENSOR_STATE(id, key, unit, desc, avgr, attr, db, dbr) {SENSOR_PENDING, 0.00, {}},
+
+typedef enum { SENSORS_LIST(SENSOR_ID) SENSORS_COUNT } sensor_id_t;
+constexpr SENSOR_DEF_t SENSORS_DEF[] = { SENSORS_LIST(SENSOR_DEF) };
+RTC_DATA_ATTR SENSOR_t SENSORS[] = { SENSORS_LIST(SENSOR_STATE) };
+
+static_assert(SENSORS_COUNT <= 32, "sensors_status is a 32 bits mask");
+static_assert(sizeof(SENSORS) <= 2048, "Sensors state doesn't fit the RTC budget");
+
+static uint32_t sensors_generation = 0; // Bumped every time the values change, clients use it to skip unchanged data
+
+// Guards SENSORS and the upload queue against the server's snapshot, writers only hold it for a few copies
+static SemaphoreHandle_t sensors_lock = NULL;
+
+static void sensorsLock()
+{
+    if (sensors_lock) xSemaphoreTake(sensors_lock, portMAX_DELAY);
+}
+
+static void sensorsUnlock()
+{
+    if (sensors_lock) xSemaphoreGive(sensors_lock);
+}
 
 extern ConfigProvider config;
-float ulp_wind_read_kph();
+float ulp_wind_read_kph(bool reset = true);
+float ulp_wind_live_kph();
+int64_t uptime();
 
-SENSOR_t *getSensor(const char* key)
+#include "drivers.h"
+
+// Only meant for configuration and template parsing, everything else should use sensor_id_t
+int getSensorId(const char* key)
 {
     for (int i = 0; i < SENSORS_COUNT; i++) {
-        if (strcmp(key, SENSORS[i].key) == 0) {
-            return &SENSORS[i];
+        if (strcmp(key, SENSORS_DEF[i].key) == 0) {
+            return i;
         }
     }
-    return NULL;
+    return -1;
 }
 
 
-static void setSensorValue(const char *key, float value)
+static void setSensorValue(int id, float value)
 {
-    SENSOR_t *handle = getSensor(key);
-    if (handle->count + 1 < handle->nsamples)
-        handle->count++;
-    handle->avg = (handle->avg * ((float)(handle->count - 1) / handle->count)) + value / handle->count;
+    SENSOR_t *handle = &SENSORS[id];
     handle->val = value;
     handle->status = SENSOR_OK;
-    if (value < handle->min || handle->count == 1) handle->min = value;
-    if (value > handle->max || handle->count == 1) handle->max = value;
+    statsUpdate(&handle->stats, value, SENSORS_DEF[id].nsamples, uptime());
 }
 
 
-static void setSensorError(const char *key, short status = SENSOR_ERR_UNKNOWN)
+static void setSensorError(int id, short status = SENSOR_ERR_UNKNOWN)
 {
-    SENSOR_t *handle = getSensor(key);
+    SENSOR_t *handle = &SENSORS[id];
     handle->status = status;
     handle->val = 0;
 }
@@ -92,100 +115,329 @@ static void setSensorError(const char *key, short status = SENSOR_ERR_UNKNOWN)
 
 void pollSensors()
 {
-    float attributes[0xFF];
-    ARRAY_FILL(attributes, 0, 0xFF, SENSOR_ATTR_NOT_SET);
+    struct {
+        bool active;
+        short status;
+        unsigned long deadline;
+        int count; // Number of values read
+        float values[SENSOR_DRIVER_MAX_VALUES];
+    } state[SENSOR_DRIVERS_COUNT] = {};
+    int8_t sensor_driver[SENSORS_COUNT];
+    int pending = 0;
 
+    // Find the drivers that we need
     for (int i = 0; i < SENSORS_COUNT; i++) {
-        uint8_t type = SENSORS[i].attr & 0xF0;
-        float a = 0, b = 0, c = 0, d = 0;
-
-        if (attributes[type] == SENSOR_ATTR_NOT_SET) {
-            ARRAY_FILL(attributes, type, 0x0F, SENSOR_ATTR_PENDING);
-
-            if (type == SENSOR_DHT) {
-                if (dht_read(DHT_TYPE, DHT_PIN, &a, &b)) {
-                    attributes[SENSOR_DHT|0] = a;
-                    attributes[SENSOR_DHT|1] = b;
-                    ESP_LOGI(__func__, "DHT: %.2f %.2f", a, b);
-                } else {
-                    ESP_LOGE(__func__, "DHT sensor not responding");
-                }
+        sensor_driver[i] = -1;
+        for (int d = 0; d < SENSOR_DRIVERS_COUNT; d++) {
+            if (SENSOR_DRIVERS[d].type == SENSOR_TYPE(SENSORS_DEF[i].attr)) {
+                sensor_driver[i] = d;
+                state[d].status = SENSOR_PENDING;
+                break;
             }
-            else if (type == SENSOR_BMP) {
-                if (BMP180_read(BMP180_I2C_ADDR, &a, &b)) {
-                    attributes[SENSOR_BMP|0] = a;
-                    attributes[SENSOR_BMP|1] = b;
-                    ESP_LOGI(__func__, "BMP: %.2f %.2f", a, b);
-                } else {
-                    ESP_LOGE(__func__, "BMP180 sensor not responding");
-                }
+        }
+        if (sensor_driver[i] < 0) {
+            ESP_LOGE(__func__, "Unknown sensor 0x%x claimed by '%s'", SENSORS_DEF[i].attr, SENSORS_DEF[i].key);
+        }
+    }
+
+    // Start all the conversions at once
+    for (int d = 0; d < SENSOR_DRIVERS_COUNT; d++) {
+        const SENSOR_DRIVER_t *driver = &SENSOR_DRIVERS[d];
+        if (state[d].status != SENSOR_PENDING) {
+            continue;
+        }
+        if (!driver->begin()) {
+            ESP_LOGE(__func__, "%s sensor not responding", driver->name);
+            state[d].status = SENSOR_ERR_UNKNOWN;
+            continue;
+        }
+        state[d].deadline = millis() + (driver->start ? driver->start() : 0);
+        state[d].active = true;
+        pending++;
+    }
+
+    // Then collect the results in whatever order they become ready
+    unsigned long timeout = millis() + SENSOR_DRIVER_TIMEOUT;
+
+    while (pending > 0) {
+        for (int d = 0; d < SENSOR_DRIVERS_COUNT; d++) {
+            const SENSOR_DRIVER_t *driver = &SENSOR_DRIVERS[d];
+            if (!state[d].active) {
+                continue;
             }
-            else if (type == SENSOR_BME) {
-                Adafruit_BME280 bme280;
-                if (bme280.begin()) {
-                    attributes[SENSOR_BME|0] = a = bme280.readTemperature();
-                    attributes[SENSOR_BME|1] = b = bme280.readHumidity();
-                    attributes[SENSOR_BME|2] = c = bme280.readPressure() / 1000;
-                    ESP_LOGI(__func__, "BME: %.2f %.2f %.2f", a, b, c);
-                } else {
-                    ESP_LOGE(__func__, "BME280 sensor not responding");
-                }
+
+            bool ready = driver->ready ? driver->ready() : (millis() >= state[d].deadline);
+
+            if (ready) {
+                state[d].count = driver->read(state[d].values);
+                state[d].status = (state[d].count > 0) ? SENSOR_OK : SENSOR_ERR_UNKNOWN;
+            } else if (millis() >= timeout) {
+                state[d].status = SENSOR_ERR_TIMEOUT;
+            } else {
+                continue;
             }
-            else if (type == SENSOR_ADS) {
-                Adafruit_ADS1115 ads;
-                float vbit = 0.000125;
-                if (ads.begin()) {
-                    ads.setGain(GAIN_ONE); // real range is vdd + 0.3
-                    attributes[SENSOR_ADS|0] = a = (short)ads.readADC_SingleEnded(0) * vbit * CFG_DBL("sensors.adc.adc0_multiplier");
-                    attributes[SENSOR_ADS|1] = b = (short)ads.readADC_SingleEnded(1) * vbit * CFG_DBL("sensors.adc.adc1_multiplier");
-                    attributes[SENSOR_ADS|2] = c = (short)ads.readADC_SingleEnded(2) * vbit * CFG_DBL("sensors.adc.adc2_multiplier");
-                    attributes[SENSOR_ADS|3] = d = (short)ads.readADC_SingleEnded(3) * vbit * CFG_DBL("sensors.adc.adc3_multiplier");
-                    delay(50); // There seem to be some issue with the ADC, as maxounette foresaw
-                    ESP_LOGI(__func__, "ADC: %.2f %.2f %.2f %.2f", a, b, c, d);
-                } else {
-                    ESP_LOGE(__func__, "ADS1115 sensor not responding");
-                }
+
+            if (state[d].status == SENSOR_OK) {
+                ESP_LOGI(__func__, "%s: %.2f %.2f %.2f %.2f", driver->name,
+                    state[d].values[0], state[d].values[1], state[d].values[2], state[d].values[3]);
+            } else {
+                ESP_LOGE(__func__, "%s sensor read failed (%d)", driver->name, state[d].status);
             }
-            else if (type == SENSOR_WIND) {
-                attributes[SENSOR_WIND|0] = a = ulp_wind_read_kph();
-                attributes[SENSOR_WIND|1] = b = 0;
-                ESP_LOGI(__func__, "WIND: %.2f %.2f", a, b);
+
+            if (driver->sleep) {
+                driver->sleep();
             }
-            else if (type == SENSOR_NULL) {
-                ARRAY_FILL(attributes, SENSOR_NULL, 0x0F, 0);
-                ESP_LOGI(__func__, "NULL: 0 0 0 0 0 0 0 0");
+
+            state[d].active = false;
+            pending--;
+        }
+
+        if (pending > 0) {
+            vTaskDelay(1); // delay(1) would spin, the tick is longer than a millisecond
+        }
+    }
+
+    sensorsLock();
+    for (int i = 0; i < SENSORS_COUNT; i++) {
+        int d = sensor_driver[i];
+        int channel = SENSOR_CHANNEL(SENSORS_DEF[i].attr);
+
+        if (d >= 0 && state[d].status == SENSOR_OK && channel < state[d].count) {
+            setSensorValue(i, state[d].values[channel]);
+        } else {
+            setSensorError(i, d >= 0 ? state[d].status : SENSOR_ERR_UNKNOWN);
+        }
+    }
+    sensors_generation++;
+    sensorsUnlock();
+}
+
+
+// Template tokens: $key.N for the current value, $key.stat.N for a statistic (N is the precision)
+typedef enum {
+    DISPLAY_STAT_VAL,
+    DISPLAY_STAT_AVG,
+    DISPLAY_STAT_DEV,
+    DISPLAY_STAT_EWMA,
+    DISPLAY_STAT_MIN,
+    DISPLAY_STAT_MAX,
+} display_stat_t;
+
+typedef struct {
+    const char *text; // Literal, points into the template (not NUL terminated)
+    uint16_t length;  // Literal length, 0 for a sensor token
+    int8_t sensor;    // sensor_id_t
+    uint8_t stat;     // display_stat_t
+    uint8_t precision;
+} display_token_t;
+
+#define DISPLAY_TOKENS_MAX 96
+#define DISPLAY_BUFFER_SIZE 1024
+
+static const char *DISPLAY_STATS[] = {"", "avg", "dev", "ewma", "min", "max"};
+static display_token_t display_tokens[DISPLAY_TOKENS_MAX];
+static int display_tokens_count = 0;
+
+
+// Called whenever the configuration is resolved. The tokens point into the template string, which must stay
+// valid until the next call (CFG_STR() values are owned by config_strings, not by the cJSON tree).
+static void compileDisplayTemplate(const char *tpl)
+{
+    display_token_t *literal = NULL;
+    display_tokens_count = 0;
+
+    while (*tpl && display_tokens_count < DISPLAY_TOKENS_MAX) {
+        if (*tpl == '$') {
+            // $key.N or $key.stat.N
+            char key[16] = "", stat[8] = "";
+            int precision = -1, length = 0;
+            if (sscanf(tpl, "$%15[a-z0-9].%7[a-z].%1d%n", key, stat, &precision, &length) != 3) {
+                stat[0] = 0;
+                length = 0;
+                if (sscanf(tpl, "$%15[a-z0-9].%1d%n", key, &precision, &length) != 2) {
+                    length = 0;
+                }
             }
-            else {
-                ESP_LOGE(__func__, "Unknown sensor 0x%x claimed by '%s'", SENSORS[i].attr, SENSORS[i].key);
+
+            int sensor = length ? getSensorId(key) : -1;
+            int stat_id = -1;
+            for (int i = 0; i < 6; i++) {
+                if (strcmp(stat, DISPLAY_STATS[i]) == 0) stat_id = i;
+            }
+
+            if (sensor >= 0 && stat_id >= 0) {
+                display_token_t *token = &display_tokens[display_tokens_count++];
+                token->text = NULL;
+                token->length = 0;
+                token->sensor = sensor;
+                token->stat = stat_id;
+                token->precision = precision;
+                literal = NULL;
+                tpl += length;
+                continue;
             }
         }
 
-        if (attributes[SENSORS[i].attr] != SENSOR_ATTR_PENDING) {
-            setSensorValue(SENSORS[i].key, attributes[SENSORS[i].attr]);
-        } else {
-            setSensorError(SENSORS[i].key, SENSOR_ERR_UNKNOWN);
+        if (literal == NULL) {
+            literal = &display_tokens[display_tokens_count++];
+            literal->text = tpl;
+            literal->length = 0;
         }
+        literal->length++;
+        tpl++;
+    }
+
+    if (*tpl) {
+        ESP_LOGW(__func__, "Display template is too long, it will be truncated");
+    }
+}
+
+
+static float getSensorStat(int id, int stat, int64_t now)
+{
+    const sensor_stats_t *stats = &SENSORS[id].stats;
+    switch (stat) {
+        case DISPLAY_STAT_AVG:  return statsWindowMean(stats);
+        case DISPLAY_STAT_DEV:  return statsStdDev(stats);
+        case DISPLAY_STAT_EWMA: return stats->ewma;
+        case DISPLAY_STAT_MIN:  return statsRolling(stats, now, false);
+        case DISPLAY_STAT_MAX:  return statsRolling(stats, now, true);
+        default:                return SENSORS[id].val;
+    }
+}
+
+
+// Renders one token at the end of buffer, returns the new length
+static size_t renderDisplayToken(const display_token_t *token, char *buffer, size_t length, int64_t now)
+{
+    size_t avail = DISPLAY_BUFFER_SIZE - length;
+    int written;
+
+    if (token->length > 0) {
+        written = snprintf(buffer + length, avail, "%.*s", token->length, token->text);
+    } else if (token->stat == DISPLAY_STAT_VAL ? SENSORS[token->sensor].status == SENSOR_OK
+                                               : SENSORS[token->sensor].stats.n > 0) {
+        written = snprintf(buffer + length, avail, "%.*f%s", token->precision,
+            getSensorStat(token->sensor, token->stat, now), SENSORS_DEF[token->sensor].unit);
+    } else {
+        written = snprintf(buffer + length, avail, "ERR");
     }
+
+    return (written < 0) ? length : (length + written >= DISPLAY_BUFFER_SIZE ? DISPLAY_BUFFER_SIZE - 1 : length + written);
 }
 
 
 void displaySensors()
 {
-    String content = CFG_STR("STATION.DISPLAY_CONTENT");
-    char buffer1[32], buffer2[32];
+    char buffer[DISPLAY_BUFFER_SIZE] = "";
+    size_t length = 0;
+    int64_t now = uptime();
 
-    for (int i = 0; i < SENSORS_COUNT; i++) {
-        for (int d = 0; d < 6; d++) { // That's a very lazy way to do it :S
-            if (SENSORS[i].status == 0) {
-                sprintf(buffer1, "%%.%df%%s", d);
-                sprintf(buffer2, buffer1, SENSORS[i].val, SENSORS[i].unit);
+    for (int i = 0; i < display_tokens_count; i++) {
+        length = renderDisplayToken(&display_tokens[i], buffer, length, now);
+    }
+
+    Display.write(buffer, length);
+    Display.flush();
+}
+
+
+// Re-read the sensors that support it (drivers with peek) without touching their statistics
+static void peekSensors()
+{
+    float values[SENSOR_DRIVER_MAX_VALUES];
+
+    for (int d = 0; d < SENSOR_DRIVERS_COUNT; d++) {
+        const SENSOR_DRIVER_t *driver = &SENSOR_DRIVERS[d];
+        if (driver->peek == NULL) { // pollSensors() already ran begin()
+            continue;
+        }
+        int count = driver->peek(values);
+        bool changed = false;
+        sensorsLock();
+        for (int i = 0; i < SENSORS_COUNT; i++) {
+            int channel = SENSOR_CHANNEL(SENSORS_DEF[i].attr);
+            if (SENSOR_TYPE(SENSORS_DEF[i].attr) == driver->type && channel < count) {
+                changed |= SENSORS[i].val != values[channel] || SENSORS[i].status != SENSOR_OK;
+                SENSORS[i].val = values[channel];
+                SENSORS[i].status = SENSOR_OK;
+            }
+        }
+        if (changed) {
+            sensors_generation++; // Otherwise /sensors clients keep their cached copy
+        }
+        sensorsUnlock();
+    }
+}
+
+
+// Live dashboard: the template is drawn once, then only the fields whose text changed are redrawn
+#define DISPLAY_FIELDS_MAX 32
+
+typedef struct {
+    uint8_t token;    // Index in display_tokens
+    uint8_t col, row; // Position on screen
+    char text[24];    // What is currently shown
+} display_field_t;
+
+static display_field_t display_fields[DISPLAY_FIELDS_MAX];
+static int display_fields_count = 0;
+static bool display_fields_valid = false;
+
+
+void displayDashboard(bool refresh)
+{
+    char buffer[DISPLAY_BUFFER_SIZE];
+    int64_t now = uptime();
+    bool changed = false;
+
+    if (refresh && display_fields_valid) {
+        peekSensors();
+
+        for (int i = 0; i < display_fields_count; i++) {
+            display_field_t *field = &display_fields[i];
+            size_t length = renderDisplayToken(&display_tokens[field->token], buffer, 0, now);
+            if (strcmp(buffer, field->text) == 0) {
+                continue;
+            }
+            if (length != strlen(field->text)) {
+                refresh = false; // Everything after it moves, redraw it all
+                break;
+            }
+            Display.printAt(field->col, field->row, buffer, length);
+            strcpy(field->text, buffer);
+            changed = true;
+        }
+
+        if (refresh) {
+            if (changed) Display.flush();
+            return;
+        }
+    }
+
+    Display.clear();
+    display_fields_count = 0;
+    display_fields_valid = true;
+
+    for (int i = 0; i < display_tokens_count; i++) {
+        size_t length = renderDisplayToken(&display_tokens[i], buffer, 0, now);
+        if (display_tokens[i].length == 0) {
+            if (display_fields_count < DISPLAY_FIELDS_MAX && length < sizeof(display_fields[0].text)) {
+                display_field_t *field = &display_fields[display_fields_count++];
+                field->token = i;
+                field->col = Display.col();
+                field->row = Display.row();
+                strcpy(field->text, buffer);
             } else {
-                strcpy(buffer2, "ERR");
+                display_fields_valid = false;
             }
-            sprintf(buffer1, "$%s.%d", SENSORS[i].key, d);
-            content.replace(buffer1, buffer2);
         }
+        Display.write(buffer, length);
     }
+    Display.flush();
 
-    Display.printf("%s", content.c_str());
+    // Fields can't be found again once the content scrolled
+    if (Display.scrolled()) {
+        display_fields_valid = false;
+    }
 }
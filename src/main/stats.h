@@ -0,0 +1,123 @@
+#define STATS_WINDOW_MAX 10    // Samples kept for the exact windowed mean
+#define STATS_EWMA_ALPHA 0.25f // Weight of the newest sample
+#define STATS_BUCKETS 4        // Rolling min/max window is STATS_BUCKETS * STATS_BUCKET_SPAN
+#define STATS_BUCKET_SPAN 900  // Seconds
+
+// Per sensor statistics, kept in RTC memory. Every update is O(1), the deviation is O(window) to read.
+typedef struct {
+    float window[STATS_WINDOW_MAX]; // Ring of the last samples
+    float window_sum;               //
+    uint8_t window_size;            // Size the ring was filled with
+    uint8_t window_pos;             // Next slot to write
+    uint8_t window_len;             // Number of valid samples in the ring
+    uint32_t n;                     // Samples seen since the last reset
+    float ewma;                     // Exponentially weighted moving average
+    struct {
+        uint16_t epoch;             // Time / STATS_BUCKET_SPAN, truncated
+        float min;
+        float max;
+    } buckets[STATS_BUCKETS];
+} sensor_stats_t;
+
+
+static void statsReset(sensor_stats_t *stats)
+{
+    memset(stats, 0, sizeof(sensor_stats_t));
+}
+
+
+static void statsUpdate(sensor_stats_t *stats, float value, int window_size, int64_t now)
+{
+    if (window_size > STATS_WINDOW_MAX) window_size = STATS_WINDOW_MAX;
+    if (window_size < 1) window_size = 1;
+
+    // The window size can change with the configuration, start over if it does
+    if (stats->window_size != window_size) {
+        stats->window_size = window_size;
+        stats->window_len = stats->window_pos = 0;
+        stats->window_sum = 0;
+    }
+
+    if (stats->window_len == window_size) {
+        stats->window_sum -= stats->window[stats->window_pos];
+    } else {
+        stats->window_len++;
+    }
+    stats->window[stats->window_pos] = value;
+    stats->window_sum += value;
+    stats->window_pos = (stats->window_pos + 1) % window_size;
+
+    // Resync the running sum once per lap so that rounding errors can't accumulate
+    if (stats->window_pos == 0) {
+        stats->window_sum = 0;
+        for (int i = 0; i < stats->window_len; i++) {
+            stats->window_sum += stats->window[i];
+        }
+    }
+
+    stats->n++;
+    stats->ewma = (stats->n == 1) ? value : stats->ewma + STATS_EWMA_ALPHA * (value - stats->ewma);
+
+    uint16_t epoch = (uint16_t)(now / 1000 / STATS_BUCKET_SPAN);
+    if (stats->n == 1) { // Mark every bucket as expired
+        for (int i = 0; i < STATS_BUCKETS; i++) {
+            stats->buckets[i].epoch = epoch - STATS_BUCKETS;
+        }
+    }
+    auto *bucket = &stats->buckets[epoch % STATS_BUCKETS];
+    if (bucket->epoch != epoch) {
+        bucket->epoch = epoch;
+        bucket->min = bucket->max = value;
+    } else {
+        if (value < bucket->min) bucket->min = value;
+        if (value > bucket->max) bucket->max = value;
+    }
+}
+
+
+static inline float statsWindowMean(const sensor_stats_t *stats)
+{
+    return stats->window_len ? stats->window_sum / stats->window_len : 0;
+}
+
+
+// Sample deviation over the same window as statsWindowMean(), two passes so that large means don't cost precision
+static float statsStdDev(const sensor_stats_t *stats)
+{
+    if (stats->window_len < 2) {
+        return 0;
+    }
+    float mean = statsWindowMean(stats), sum = 0;
+    for (int i = 0; i < stats->window_len; i++) {
+        float delta = stats->window[i] - mean;
+        sum += delta * delta;
+    }
+    return sqrtf(sum / (stats->window_len - 1));
+}
+
+
+// Min (or max) of the buckets that are still inside the rolling window
+static float statsRolling(const sensor_stats_t *stats, int64_t now, bool max)
+{
+    uint16_t epoch = (uint16_t)(now / 1000 / STATS_BUCKET_SPAN);
+    float result = 0;
+    bool found = false;
+
+    if (stats->n == 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < STATS_BUCKETS; i++) {
+        auto *bucket = &stats->buckets[i];
+        if ((uint16_t)(epoch - bucket->epoch) >= STATS_BUCKETS) {
+            continue;
+        }
+        float value = max ? bucket->max : bucket->min;
+        if (!found || (max ? value > result : value < result)) {
+            result = value;
+            found = true;
+        }
+    }
+
+    return result;
+}
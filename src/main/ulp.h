@@ -1,18 +1,44 @@
 #include <driver/rtc_io.h>
+#include <soc/gpio_reg.h>
 #include <esp32/ulp.h>
+#include <esp_timer.h>
 #include <esp_log.h>
 
 extern const uint8_t ulp_wind_bin_start[] asm("_binary_ulp_wind_bin_start");
 extern const uint8_t ulp_wind_bin_end[]   asm("_binary_ulp_wind_bin_end");
 // Maybe we should use a circular buffer so we can get average/mean/max/min?
 extern uint32_t ulp_edge_count_max;
+extern uint32_t ulp_edge_count;
+extern uint32_t ulp_next_edge;
 extern uint32_t ulp_loops_in_period;
+extern uint32_t ulp_loops_before_reset;
 extern uint32_t ulp_rtc_io;
 extern uint32_t ulp_entry;
 
 const uint32_t ulp_wind_sample_length_us = 10 * 1000 * 1000;
 const uint32_t ulp_wind_period_us = 500;
 
+// While awake the anemometer is counted by a GPIO interrupt instead of the ULP. Its counts are folded
+// into the ULP's own variables so that the gust series continues across the handovers. To count the
+// way the ULP does, an edge is only taken if it is the level the ULP expects next and if it comes at
+// least one ULP period after the previous one (the ULP's sampling is what debounces the reed switch).
+#define WIND_LIVE_SYNC_US 100000  // Fold the counts into the ULP's window at that interval
+#define WIND_LIVE_SLOTS 10        // Live speed is averaged over that many syncs (1s)
+
+static struct {
+    gpio_num_t gpio;
+    esp_timer_handle_t timer;
+    volatile uint32_t edges;      // Counted by the interrupt
+    volatile int64_t last_edge;   // When it counted the last one (us)
+    volatile uint8_t next_edge;   // Same meaning as ulp_next_edge
+    uint32_t last_edges;
+    int64_t last_sync;
+    uint32_t leftover_us;         // Time not yet converted into ULP loops
+    uint16_t live[WIND_LIVE_SLOTS];
+    uint8_t live_pos;
+    uint8_t live_len;
+} wind_live = {GPIO_NUM_MAX};
+
 void ulp_wind_start(gpio_num_t gpio_num)
 {
     esp_err_t err = ulp_load_binary(0, ulp_wind_bin_start,
@@ -46,15 +72,161 @@ void ulp_wind_start(gpio_num_t gpio_num)
 }
 
 
-float ulp_wind_read_kph()
+static float wind_kph(uint32_t edges, float seconds)
 {
-    float rotations = (ulp_edge_count_max & UINT16_MAX) / 2;
-    float rpm = rotations / (ulp_wind_sample_length_us / 1000 / 1000) * 60;
-    float circ = (2 * 3.141592 * CFG_DBL("sensors.anemometer.radius")) / 100 / 1000;
-    float kph = rpm * 60 * circ * CFG_DBL("sensors.anemometer.calibration");
+    float rotations = edges / 2;
+    float rpm = rotations / seconds * 60;
+    float circ = (2 * 3.141592 * CFG_DBL(ANEMOMETER_RADIUS)) / 100 / 1000;
+    return rpm * 60 * circ * CFG_DBL(ANEMOMETER_CALIBRATION);
+}
+
+
+float ulp_wind_read_kph(bool reset)
+{
+    float kph = wind_kph(ulp_edge_count_max & UINT16_MAX, ulp_wind_sample_length_us / 1000 / 1000);
 
     // Reset the counter
-    ulp_edge_count_max = 0;
+    if (reset) {
+        ulp_edge_count_max = 0;
+    }
 
     return kph;
 }
+
+
+static void IRAM_ATTR ulp_wind_live_edge(void *arg)
+{
+    int64_t now = esp_timer_get_time();
+    if (now - wind_live.last_edge < ulp_wind_period_us) {
+        return; // Bounce, the ULP wouldn't have sampled it
+    }
+    int gpio = wind_live.gpio; // gpio_get_level() isn't in IRAM
+    int level = (gpio < 32 ? REG_READ(GPIO_IN_REG) >> gpio : REG_READ(GPIO_IN1_REG) >> (gpio - 32)) & 1;
+    if (level == wind_live.next_edge) {
+        wind_live.next_edge = !level;
+        wind_live.last_edge = now;
+        wind_live.edges++;
+    }
+}
+
+
+// Does what the ULP would have done for the edges and the time since the last sync
+static void ulp_wind_live_sync(void *arg = NULL)
+{
+    uint32_t count = wind_live.edges;
+    int64_t now = esp_timer_get_time();
+
+    uint32_t edges = count - wind_live.last_edges;
+    uint32_t elapsed = wind_live.leftover_us + (now - wind_live.last_sync);
+    uint32_t loops = elapsed / ulp_wind_period_us;
+    wind_live.leftover_us = elapsed % ulp_wind_period_us;
+    wind_live.last_edges = count;
+    wind_live.last_sync = now;
+
+    uint32_t edge_count = (ulp_edge_count & UINT16_MAX) + edges;
+    ulp_edge_count = edge_count;
+    if (edge_count > (ulp_edge_count_max & UINT16_MAX)) {
+        ulp_edge_count_max = edge_count;
+    }
+
+    uint32_t remaining = ulp_loops_before_reset & UINT16_MAX;
+    while (loops > 0) { // The window can only roll once per sync in practice, but be exact anyway
+        uint32_t step = std::min(loops, remaining);
+        loops -= step;
+        remaining -= step;
+        if (remaining == 0) {
+            ulp_edge_count = 0;
+            remaining = ulp_loops_in_period;
+        }
+    }
+    ulp_loops_before_reset = remaining;
+
+    wind_live.live[wind_live.live_pos] = edges;
+    wind_live.live_pos = (wind_live.live_pos + 1) % WIND_LIVE_SLOTS;
+    if (wind_live.live_len < WIND_LIVE_SLOTS) wind_live.live_len++;
+}
+
+
+// Takes the pin away from the ULP. An edge that happened after the ULP's last sample is counted here.
+void ulp_wind_live_start()
+{
+    gpio_num_t gpio = (gpio_num_t)ANEMOMETER_PIN;
+
+    if (wind_live.gpio != GPIO_NUM_MAX) {
+        return;
+    }
+
+    REG_CLR_BIT(RTC_CNTL_STATE0_REG, RTC_CNTL_ULP_CP_SLP_TIMER_EN);
+    delayMicroseconds(ulp_wind_period_us); // Let a run in progress halt
+
+    rtc_gpio_hold_dis(gpio);
+    rtc_gpio_deinit(gpio);
+    gpio_set_direction(gpio, GPIO_MODE_INPUT);
+    gpio_set_pull_mode(gpio, GPIO_PULLUP_ONLY);
+
+    wind_live.gpio = gpio;
+    wind_live.edges = wind_live.last_edges = 0;
+    wind_live.last_edge = wind_live.last_sync = esp_timer_get_time();
+    wind_live.leftover_us = 0;
+    wind_live.live_len = wind_live.live_pos = 0;
+
+    // next_edge is the level the ULP expects next, if the pin is already there it missed that edge
+    wind_live.next_edge = ulp_next_edge & 1;
+    if (gpio_get_level(gpio) == wind_live.next_edge) {
+        wind_live.next_edge = !wind_live.next_edge;
+        ulp_edge_count = (ulp_edge_count & UINT16_MAX) + 1;
+    }
+    attachInterruptArg(gpio, ulp_wind_live_edge, NULL, CHANGE);
+
+    if (wind_live.timer == NULL) {
+        esp_timer_create_args_t args = {};
+        args.callback = &ulp_wind_live_sync;
+        args.name = "wind_live";
+        esp_timer_create(&args, &wind_live.timer);
+    }
+    esp_timer_start_periodic(wind_live.timer, WIND_LIVE_SYNC_US);
+
+    ESP_LOGI("ULP", "Wind counting handed to the CPU");
+}
+
+
+// Gives the pin back to the ULP, it resumes with the level we expect next so no edge is counted twice or lost
+void ulp_wind_live_stop()
+{
+    gpio_num_t gpio = wind_live.gpio;
+
+    if (gpio == GPIO_NUM_MAX) {
+        return;
+    }
+
+    esp_timer_stop(wind_live.timer);
+    detachInterrupt(gpio);
+    ulp_wind_live_sync();
+    ulp_next_edge = wind_live.next_edge;
+
+    rtc_gpio_init(gpio);
+    rtc_gpio_set_direction(gpio, RTC_GPIO_MODE_INPUT_ONLY);
+    rtc_gpio_pulldown_dis(gpio);
+    rtc_gpio_pullup_en(gpio);
+    rtc_gpio_hold_en(gpio);
+
+    REG_SET_BIT(RTC_CNTL_STATE0_REG, RTC_CNTL_ULP_CP_SLP_TIMER_EN);
+    wind_live.gpio = GPIO_NUM_MAX;
+
+    ESP_LOGI("ULP", "Wind counting handed back to the ULP");
+}
+
+
+// Speed over the last second while the CPU counts, the ULP's current gust otherwise
+float ulp_wind_live_kph()
+{
+    uint32_t edges = 0;
+
+    if (wind_live.gpio == GPIO_NUM_MAX || wind_live.live_len == 0) {
+        return ulp_wind_read_kph(false);
+    }
+    for (int i = 0; i < wind_live.live_len; i++) {
+        edges += wind_live.live[i];
+    }
+    return wind_kph(edges, wind_live.live_len * WIND_LIVE_SYNC_US / 1e6);
+}